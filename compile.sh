@@ -1 +1,3 @@
-g++ -o bin/a src/*.cpp src/**/*.cpp -O2 -I/usr/include/SDL2 -D_REENTRANT -lSDL2 -L/usr/lib/x86_64-linux-gnu -lSDL2_image
+g++ -o bin/a src/*.cpp src/**/*.cpp -O2 -I/usr/include/SDL2 -D_REENTRANT -pthread -lSDL2 -L/usr/lib/x86_64-linux-gnu -lSDL2_image
+g++ -o bin/resultStats tools/resultStats.cpp src/stats/results.cpp -O2 -pthread
+g++ -o bin/auditBoards tools/auditBoards.cpp src/minesweeper/board.cpp -O2 -pthread
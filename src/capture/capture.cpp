@@ -0,0 +1,210 @@
+#include "capture.h"
+#include "../spritelib/scale.h"
+#include <iostream>
+#include <algorithm>
+
+FrameCapture::FrameCapture()
+{
+  this->output = nullptr;
+  this->isPipe = false;
+  this->width = 0;
+  this->height = 0;
+  this->scale = 1;
+  this->format = CAPTURE_FORMAT_Y4M;
+  this->closing = false;
+  this->queued = -1;
+  this->writing = -1;
+  this->framesWritten = 0;
+  this->framesDropped = 0;
+}
+
+FrameCapture::~FrameCapture()
+{
+  this->close();
+}
+
+bool FrameCapture::open(std::string path, uint16_t width, uint16_t height, int scale, int fps, CaptureFormat format)
+{
+  this->close();
+
+  if (path == "-")
+  {
+    this->output = stdout;
+  }
+  else if (!path.empty() && path[0] == '|')
+  {
+    this->output = popen(path.substr(1).c_str(), "w");
+    this->isPipe = true;
+  }
+  else
+  {
+    this->output = fopen(path.c_str(), "wb");
+  }
+
+  if (this->output == nullptr)
+  {
+    std::cout << "Could not open capture output: " << path << std::endl;
+    return false;
+  }
+
+  this->width = width;
+  this->height = height;
+  this->scale = std::max(scale, 1);
+  this->format = format;
+  this->closing = false;
+  this->queued = -1;
+  this->writing = -1;
+  this->framesWritten = 0;
+  this->framesDropped = 0;
+
+  for (int i = 0; i < 2; i++)
+  {
+    this->buffers[i].resize(width * height);
+  }
+  this->scaled.resize(width * this->scale * height * this->scale);
+
+  if (format == CAPTURE_FORMAT_Y4M)
+  {
+    fprintf(this->output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width * this->scale, height * this->scale, fps);
+    this->converted.resize(width * height);
+    this->encoded.resize(this->scaled.size() * 3);
+  }
+
+  this->writer = std::thread(&FrameCapture::writerLoop, this);
+  return true;
+}
+
+bool FrameCapture::submitFrame(const uint32_t *pixels, bool wait)
+{
+  if (this->output == nullptr)
+    return false;
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  if (wait)
+  {
+    // lossless: let the writer take the queued frame first
+    this->changed.wait(lock, [this]()
+                       { return this->queued == -1; });
+  }
+  else if (this->queued != -1 && this->writing != -1)
+  {
+    // both buffers are busy
+    this->framesDropped++;
+    return false;
+  }
+
+  // a frame still waiting in the queue is replaced by the newer one (only without wait)
+  int target = this->queued != -1 ? this->queued : (this->writing == 0 ? 1 : 0);
+  if (this->queued != -1)
+    this->framesDropped++;
+
+  // the writer never touches a buffer that isn't queued or being written, so copy unlocked
+  this->queued = -1;
+  lock.unlock();
+  std::copy(pixels, pixels + this->width * this->height, this->buffers[target].data());
+  lock.lock();
+
+  this->queued = target;
+  this->changed.notify_all();
+  return true;
+}
+
+void FrameCapture::close()
+{
+  if (this->output == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->closing = true;
+  }
+  this->changed.notify_all();
+  this->writer.join();
+
+  if (this->isPipe)
+    pclose(this->output);
+  else if (this->output != stdout)
+    fclose(this->output);
+  else
+    fflush(stdout);
+
+  this->output = nullptr;
+  this->isPipe = false;
+}
+
+bool FrameCapture::isOpen()
+{
+  return this->output != nullptr;
+}
+
+void FrameCapture::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  while (true)
+  {
+    this->changed.wait(lock, [this]()
+                       { return this->queued != -1 || this->closing; });
+
+    // finish the queued frame before closing
+    if (this->queued == -1)
+      break;
+
+    this->writing = this->queued;
+    this->queued = -1;
+    this->changed.notify_all();
+
+    lock.unlock();
+    this->writeFrame(this->buffers[this->writing].data());
+    lock.lock();
+
+    this->writing = -1;
+    this->framesWritten++;
+    this->changed.notify_all();
+  }
+}
+
+void FrameCapture::writeFrame(const uint32_t *pixels)
+{
+  size_t pixelCount = this->scaled.size();
+
+  if (this->format == CAPTURE_FORMAT_RAW)
+  {
+    scalePixels(pixels, this->width, this->height, this->scale, this->scaled.data());
+    fwrite(this->scaled.data(), sizeof(uint32_t), pixelCount, this->output);
+    return;
+  }
+
+  // convert at the source resolution (BT.601 limited range), packed as 0x00VVUUYY,
+  // then scale that, so the color math isn't repeated for every output pixel
+  for (int i = 0; i < this->width * this->height; i++)
+  {
+    int r = (pixels[i] >> 16) & 0xFF;
+    int g = (pixels[i] >> 8) & 0xFF;
+    int b = pixels[i] & 0xFF;
+
+    uint32_t y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    uint32_t u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    uint32_t v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    this->converted[i] = (v << 16) | (u << 8) | y;
+  }
+
+  scalePixels(this->converted.data(), this->width, this->height, this->scale, this->scaled.data());
+
+  // one plane each for Y, U and V
+  uint8_t *planeY = this->encoded.data();
+  uint8_t *planeU = planeY + pixelCount;
+  uint8_t *planeV = planeU + pixelCount;
+
+  for (size_t i = 0; i < pixelCount; i++)
+  {
+    uint32_t yuv = this->scaled[i];
+    planeY[i] = yuv & 0xFF;
+    planeU[i] = (yuv >> 8) & 0xFF;
+    planeV[i] = (yuv >> 16) & 0xFF;
+  }
+
+  fputs("FRAME\n", this->output);
+  fwrite(this->encoded.data(), 1, this->encoded.size(), this->output);
+}
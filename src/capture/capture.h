@@ -0,0 +1,88 @@
+#pragma once
+#include <cinttypes>
+#include <cstdio>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Output formats for frame capture
+ * Y4M: YUV4MPEG2, 4:4:4 BT.601, playable by most video tools (ffmpeg, mpv)
+ * RAW: headerless BGRA frames (ffmpeg -f rawvideo -pix_fmt bgra)
+ */
+enum CaptureFormat
+{
+  CAPTURE_FORMAT_Y4M,
+  CAPTURE_FORMAT_RAW
+};
+
+/**
+ * Streams rendered frames to a file or pipe
+ * submitFrame only copies the frame into one of two buffers. Scaling, encoding
+ * and writing happen on a writer thread, so capturing doesn't hold up the game loop.
+ */
+class FrameCapture
+{
+public:
+  FrameCapture();
+  ~FrameCapture();
+
+  /**
+   * Starts a capture
+   * @param path The file to write, "-" for stdout, or "|command" to pipe into a command
+   * @param width The width of the submitted frames
+   * @param height The height of the submitted frames
+   * @param scale The integer upscale factor of the output
+   * @param fps The frame rate written into the Y4M header
+   * @param format The output format
+   * @return false if the output could not be opened
+   */
+  bool open(std::string path, uint16_t width, uint16_t height, int scale, int fps, CaptureFormat format);
+
+  /**
+   * Queues a frame for writing
+   * @param pixels The ARGB8888 frame, width * height pixels
+   * @param wait Wait for the writer to take the queued frame, so no frame is ever lost (true),
+   *             or replace the queued frame, and drop this one if both buffers are busy (false)
+   * @return false if the frame was dropped
+   */
+  bool submitFrame(const uint32_t *pixels, bool wait);
+
+  /**
+   * Writes out any queued frame and closes the output
+   */
+  void close();
+
+  bool isOpen();
+
+  uint64_t framesWritten;
+  uint64_t framesDropped;
+
+private:
+  FILE *output;
+  bool isPipe;
+  uint16_t width;
+  uint16_t height;
+  int scale;
+  CaptureFormat format;
+
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool closing;
+
+  // the two frame buffers, and which one (if any) is queued or being written
+  std::vector<uint32_t> buffers[2];
+  int queued;
+  int writing;
+
+  // writer thread scratch space
+  std::vector<uint32_t> converted;
+  std::vector<uint32_t> scaled;
+  std::vector<uint8_t> encoded;
+
+  void writerLoop();
+  void writeFrame(const uint32_t *pixels);
+};
@@ -1,9 +1,292 @@
 #include <SDL2/SDL.h>
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
 #include "minesweeper/game.h"
+#include "minesweeper/mosaic.h"
+#include "spritelib/pixelformat.h"
+#include "runtime/runtime.h"
+#include "capture/capture.h"
+#include "stats/results.h"
+
+// maps a key to a game input, returns false for unbound keys
+static bool mapKey(int key, GameInput *input)
+{
+  input->dx = 0;
+  input->dy = 0;
+  input->timestamp = 0;
+
+  switch (key)
+  {
+  case SDLK_UP:
+    input->action = GAME_ACTION_MOVE;
+    input->dy = -1;
+    return true;
+  case SDLK_DOWN:
+    input->action = GAME_ACTION_MOVE;
+    input->dy = 1;
+    return true;
+  case SDLK_LEFT:
+    input->action = GAME_ACTION_MOVE;
+    input->dx = -1;
+    return true;
+  case SDLK_RIGHT:
+    input->action = GAME_ACTION_MOVE;
+    input->dx = 1;
+    return true;
+  case SDLK_SPACE:
+    input->action = GAME_ACTION_REVEAL;
+    return true;
+  case SDLK_f:
+    input->action = GAME_ACTION_FLAG;
+    return true;
+  case SDLK_r:
+    input->action = GAME_ACTION_RESET;
+    return true;
+  }
+
+  return false;
+}
+
+// picks a random input, for headless play
+static GameInput randomInput(Random *random)
+{
+  GameInput input = {GAME_ACTION_MOVE, 0, 0, 0};
+  uint32_t roll = random->nextBounded(100);
+
+  if (roll < 70)
+  {
+    int direction = random->nextBounded(4);
+    input.dx = direction == 0 ? -1 : (direction == 1 ? 1 : 0);
+    input.dy = direction == 2 ? -1 : (direction == 3 ? 1 : 0);
+  }
+  else if (roll < 90)
+  {
+    input.action = GAME_ACTION_REVEAL;
+  }
+  else if (roll < 98)
+  {
+    input.action = GAME_ACTION_FLAG;
+  }
+  else
+  {
+    input.action = GAME_ACTION_RESET;
+  }
+
+  return input;
+}
+
+// plays random inputs without a window, as fast as frames can be captured
+static int runHeadless(int frames, int width, int height, FrameCapture *capture, ResultStore *results)
+{
+  MinesweeperGame game;
+  game.init();
+  game.waitForLoad();
+  if (results->isOpen())
+  {
+    game.setResultStore(results);
+  }
+
+  Random random;
+  uint32_t *pixels = new uint32_t[width * height];
+
+  uint64_t start = traceNow();
+  for (int frame = 0; frame < frames; frame++)
+  {
+    applyInput(&game, randomInput(&random));
+    game.render(pixels, width, height);
+
+    if (capture->isOpen())
+    {
+      capture->submitFrame(pixels, true);
+    }
+  }
+  capture->close();
+
+  double seconds = (traceNow() - start) / 1000000.0;
+  std::cerr << frames << " frames in " << seconds << "s (" << frames / seconds << " fps)" << std::endl;
+
+  delete[] pixels;
+  return 0;
+}
+
+// plays many games with random inputs and shows them all in one window, until the window is closed
+static void runMosaic(int boardCount, int width, int height, PixelFormat format, bool dither, ResultStore *results, SDL_Renderer *renderer, SDL_Texture *texture)
+{
+  // only this game loads sprites, it draws every board
+  MinesweeperGame spriteGame;
+  spriteGame.init();
+
+  std::vector<MinesweeperGame> games(boardCount);
+  for (MinesweeperGame &game : games)
+  {
+    game.initHeadless(&spriteGame);
+    if (results->isOpen())
+    {
+      game.setResultStore(results);
+    }
+  }
+
+  GameMosaic mosaic(&spriteGame);
+  if (!mosaic.setLayout(width, height, boardCount))
+  {
+    std::cout << boardCount << " boards don't fit in " << width << "x" << height << ", try a bigger --scale" << std::endl;
+    return;
+  }
+
+  GameSnapshot snapshot;
+  for (int i = 0; i < boardCount; i++)
+  {
+    games[i].snapshot(&snapshot);
+    mosaic.updateBoard(i, &snapshot);
+  }
+
+  Random random;
+  std::vector<uint8_t> converted(width * height * 4);
+  while (true)
+  {
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+    {
+      if (e.type == SDL_QUIT)
+        return;
+    }
+
+    // every board makes a move now and then, like a room full of players
+    for (int i = 0; i < boardCount; i++)
+    {
+      if (random.nextBounded(10) != 0)
+        continue;
+
+      applyInput(&games[i], randomInput(&random));
+      games[i].snapshot(&snapshot);
+      mosaic.updateBoard(i, &snapshot);
+    }
+
+    mosaic.render();
+    convertPixels(mosaic.getPixels(), converted.data(), width, height, format, dither);
+    SDL_UpdateTexture(texture, NULL, converted.data(), width * bytesPerPixel(format));
+
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+
+    SDL_Delay(33);
+  }
+}
 
 int main(int argc, char *argv[])
 {
+  // the pixel format of the display target, e.g. "--format rgb565 --dither"
+  PixelFormat format = PIXEL_FORMAT_ARGB8888;
+  bool dither = false;
+
+  // run simulation and rendering on their own threads ("--threaded")
+  bool threaded = false;
+
+  // measure input-to-present latency ("--trace-latency"), optionally shown on screen ("--latency-overlay")
+  bool traceLatency = false;
+  bool latencyOverlay = false;
+
+  // stream frames to a file or pipe ("--capture out.y4m --capture-format y4m --capture-scale 4")
+  // the capture scale applies on top of --scale, by default the output is 1920x960 either way
+  std::string capturePath;
+  CaptureFormat captureFormat = CAPTURE_FORMAT_Y4M;
+  int captureScale = 0;
+
+  // play random inputs without a window for this many frames ("--headless 1000")
+  int headlessFrames = 0;
+
+  // append every finished game to a results file ("--results results.bin")
+  std::string resultsPath;
+
+  // show this many games playing random inputs at once ("--mosaic 64", use with --scale)
+  int mosaicBoards = 0;
+
+  // render natively at a multiple of 480x240 instead of letting SDL stretch it ("--scale 2")
+  int scale = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc)
+    {
+      if (!parsePixelFormat(argv[++i], &format))
+      {
+        std::cout << "Unknown pixel format: " << argv[i] << std::endl;
+      }
+    }
+    else if (arg == "--dither")
+    {
+      dither = true;
+    }
+    else if (arg == "--threaded")
+    {
+      threaded = true;
+    }
+    else if (arg == "--trace-latency")
+    {
+      traceLatency = true;
+    }
+    else if (arg == "--latency-overlay")
+    {
+      traceLatency = true;
+      latencyOverlay = true;
+    }
+    else if (arg == "--capture" && i + 1 < argc)
+    {
+      capturePath = argv[++i];
+    }
+    else if (arg == "--capture-format" && i + 1 < argc)
+    {
+      std::string name = argv[++i];
+      captureFormat = name == "raw" ? CAPTURE_FORMAT_RAW : CAPTURE_FORMAT_Y4M;
+    }
+    else if (arg == "--capture-scale" && i + 1 < argc)
+    {
+      captureScale = std::stoi(argv[++i]);
+    }
+    else if (arg == "--headless" && i + 1 < argc)
+    {
+      headlessFrames = std::stoi(argv[++i]);
+    }
+    else if (arg == "--mosaic" && i + 1 < argc)
+    {
+      mosaicBoards = std::stoi(argv[++i]);
+    }
+    else if (arg == "--results" && i + 1 < argc)
+    {
+      resultsPath = argv[++i];
+    }
+    else if (arg == "--scale" && i + 1 < argc)
+    {
+      scale = std::max(1, std::stoi(argv[++i]));
+    }
+  }
+
+  int width = 480 * scale;
+  int height = 240 * scale;
+
+  FrameCapture capture;
+  if (!capturePath.empty())
+  {
+    if (captureScale <= 0)
+    {
+      captureScale = std::max(1, 4 / scale);
+    }
+    capture.open(capturePath, width, height, captureScale, 30, captureFormat);
+  }
+
+  ResultStore results;
+  if (!resultsPath.empty())
+  {
+    results.open(resultsPath, true);
+  }
+
+  if (headlessFrames > 0)
+  {
+    return runHeadless(headlessFrames, width, height, &capture, &results);
+  }
 
   SDL_Init(SDL_INIT_EVERYTHING);
 
@@ -11,12 +294,55 @@ int main(int argc, char *argv[])
   // but we make it bigger so its more comfortable to debug
   SDL_Window *window = SDL_CreateWindow("Minesweeper", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 480 * 4, 240 * 4, SDL_WINDOW_SHOWN);
   SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-  SDL_RenderSetLogicalSize(renderer, 480, 240);
+  SDL_RenderSetLogicalSize(renderer, width, height);
+
+  uint32_t textureFormat = SDL_PIXELFORMAT_ARGB8888;
+  if (format == PIXEL_FORMAT_RGB565)
+  {
+    textureFormat = SDL_PIXELFORMAT_RGB565;
+  }
+  else if (format == PIXEL_FORMAT_BGR888)
+  {
+    textureFormat = SDL_PIXELFORMAT_BGR24;
+  }
+  SDL_Texture *texture = SDL_CreateTexture(renderer, textureFormat, SDL_TEXTUREACCESS_STATIC, width, height);
+
+  if (mosaicBoards > 0)
+  {
+    runMosaic(mosaicBoards, width, height, format, dither, &results, renderer, texture);
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+  }
 
   MinesweeperGame game;
   game.init();
+  if (results.isOpen())
+  {
+    game.setResultStore(&results);
+  }
 
-  uint32_t *pixels = new uint32_t[480 * 240];
+  uint32_t *pixels = new uint32_t[width * height];
+
+  // stats are logged every 5 seconds
+  LatencyTracer tracer(5000000);
+  std::vector<LatencyTag> pendingTags;
+
+  ThreadedRuntime runtime(&game, width, height, format, dither);
+  if (threaded)
+  {
+    if (latencyOverlay)
+    {
+      runtime.setLatencyOverlay(&tracer);
+    }
+    if (capture.isOpen())
+    {
+      runtime.setCapture(&capture, 30);
+    }
+    runtime.start();
+  }
 
   while (true)
   {
@@ -25,6 +351,9 @@ int main(int argc, char *argv[])
     {
       if (e.type == SDL_QUIT)
       {
+        runtime.stop();
+        capture.close();
+        SDL_DestroyTexture(texture);
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
@@ -34,46 +363,104 @@ int main(int argc, char *argv[])
       }
 
       // keypresses
-      if (e.type == SDL_KEYDOWN)
+      GameInput input;
+      if (e.type == SDL_KEYDOWN && mapKey(e.key.keysym.sym, &input))
       {
-        switch (e.key.keysym.sym)
+        if (traceLatency)
         {
-        case SDLK_UP:
-          game.moveCursor(0, -1);
-          break;
-        case SDLK_DOWN:
-          game.moveCursor(0, 1);
-          break;
-        case SDLK_LEFT:
-          game.moveCursor(-1, 0);
-          break;
-        case SDLK_RIGHT:
-          game.moveCursor(1, 0);
-          break;
-        case SDLK_SPACE:
-          game.reveal();
-          break;
-        case SDLK_f:
-          game.flag();
-          break;
-        case SDLK_r:
-          game.reset();
-          break;
+          // count the time the event spent waiting in SDL's queue too
+          uint64_t queued = (uint64_t)(SDL_GetTicks() - e.key.timestamp) * 1000;
+          input.timestamp = traceNow() - queued;
+        }
+
+        if (threaded)
+        {
+          runtime.pushInput(input);
+        }
+        else
+        {
+          applyInput(&game, input);
+
+          if (traceLatency)
+          {
+            LatencyTag tag = LatencyTag();
+            tag.input = input.timestamp;
+            tag.action = traceNow();
+            pendingTags.push_back(tag);
+          }
         }
       }
     }
 
+    if (threaded)
+    {
+      // present whatever the render thread finished last, never wait for it
+      LatencyTag tag;
+      const uint8_t *frame = runtime.acquireFrame(&tag);
+      if (frame != nullptr)
+      {
+        SDL_UpdateTexture(texture, NULL, frame, width * bytesPerPixel(format));
+        tag.upload = traceNow();
+
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        tag.present = traceNow();
+
+        if (traceLatency && tag.input != 0)
+        {
+          tracer.record(tag);
+        }
+      }
+
+      if (traceLatency)
+      {
+        tracer.tick();
+      }
+
+      SDL_Delay(1);
+      continue;
+    }
+
     // render the game
-    game.render(pixels, 480, 240);
+    game.render(pixels, width, height);
+    if (latencyOverlay && game.isReady())
+    {
+      tracer.drawOverlay(pixels, width, height, game.getSprite(20), scale);
+    }
+
+    // never hold up the game for the capture, drop the frame instead
+    if (capture.isOpen())
+    {
+      capture.submitFrame(pixels, false);
+    }
+
+    // convert to the target format in place (a no-op for ARGB8888)
+    convertPixels(pixels, (uint8_t *)pixels, width, height, format, dither);
+    uint64_t renderTime = traceNow();
 
-    // create a texture from the pixel array
-    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 480, 240);
-    SDL_UpdateTexture(texture, NULL, pixels, 480 * sizeof(Uint32));
+    // upload the pixel array to the texture
+    SDL_UpdateTexture(texture, NULL, pixels, width * bytesPerPixel(format));
+    uint64_t uploadTime = traceNow();
 
     // render the texture to the screen
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
+    uint64_t presentTime = traceNow();
+
+    if (traceLatency)
+    {
+      for (LatencyTag &tag : pendingTags)
+      {
+        tag.render = renderTime;
+        tag.upload = uploadTime;
+        tag.present = presentTime;
+        tracer.record(tag);
+      }
+      pendingTags.clear();
+      tracer.tick();
+    }
 
     SDL_Delay(33);
   }
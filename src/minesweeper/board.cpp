@@ -0,0 +1,128 @@
+#include "board.h"
+#include <algorithm>
+
+int transformCell(int cell, int transform)
+{
+  int x = cell % 30;
+  int y = cell / 30;
+
+  if (transform & BOARD_FLIP_HORIZONTAL)
+    x = 29 - x;
+  if (transform & BOARD_FLIP_VERTICAL)
+    y = 12 - y;
+
+  return x + y * 30;
+}
+
+uint8_t readBoardNibble(const uint8_t *boardEntry, int cell)
+{
+  uint8_t chunk = boardEntry[cell / 2];
+
+  // the even cell is stored in the high nibble
+  if ((cell % 2) == 0)
+    return chunk >> 4;
+
+  return chunk & 0x0F;
+}
+
+void fillBoardNumbers(uint8_t *board)
+{
+  // every mine bumps its neighbors, so only mines do a 3x3 pass instead of every tile counting its own
+  for (int y = 0; y < 13; y++)
+  {
+    for (int x = 0; x < 30; x++)
+    {
+      if (board[x + y * 30] != 9)
+        continue;
+
+      for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, 12); ny++)
+      {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, 29); nx++)
+        {
+          uint8_t &tile = board[nx + ny * 30];
+          if (tile != 9)
+            tile++;
+        }
+      }
+    }
+  }
+}
+
+int findOpenings(const uint8_t *board, int16_t *openings)
+{
+  uint16_t stack[30 * 13];
+  int count = 0;
+
+  for (int i = 0; i < 30 * 13; i++)
+    openings[i] = -1;
+
+  for (int i = 0; i < 30 * 13; i++)
+  {
+    if (board[i] != 0 || openings[i] != -1)
+      continue;
+
+    // flood the empty tiles connected to this one
+    int top = 0;
+    stack[top++] = i;
+    openings[i] = count;
+    while (top > 0)
+    {
+      int cell = stack[--top];
+      int x = cell % 30;
+      int y = cell / 30;
+
+      for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, 12); ny++)
+      {
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, 29); nx++)
+        {
+          int neighbor = nx + ny * 30;
+          if (board[neighbor] != 0 || openings[neighbor] != -1)
+            continue;
+
+          openings[neighbor] = count;
+          stack[top++] = neighbor;
+        }
+      }
+    }
+    count++;
+  }
+
+  return count;
+}
+
+int countBBBV(const uint8_t *board)
+{
+  int16_t openings[30 * 13];
+
+  // every opening is one click, and clears its numbered border too
+  int bbbv = findOpenings(board, openings);
+
+  // numbered tiles not bordering an opening need a click each
+  for (int x = 0; x < 30; x++)
+  {
+    for (int y = 0; y < 13; y++)
+    {
+      uint8_t tile = board[x + y * 30];
+      if (tile == 0 || tile == 9)
+        continue;
+
+      bool bordersOpening = false;
+      for (int dx = -1; dx <= 1; dx++)
+      {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+          if (x + dx < 0 || x + dx >= 30 || y + dy < 0 || y + dy >= 13)
+            continue;
+
+          if (openings[x + dx + (y + dy) * 30] != -1)
+            bordersOpening = true;
+        }
+      }
+
+      if (!bordersOpening)
+        bbbv++;
+    }
+  }
+
+  return bbbv;
+}
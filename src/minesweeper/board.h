@@ -0,0 +1,60 @@
+#pragma once
+#include <cinttypes>
+
+/**
+ * Helpers for the 30x13 board and the encoded pool boards in boards.bin
+ * (a uint16 board count, then ENCODED_BOARD_SIZE bytes per board)
+ */
+
+const int ENCODED_BOARD_SIZE = 195;
+const int MINE_COUNT = 80;
+
+/**
+ * Symmetry transforms for pool boards
+ * A 30x13 board is closed under both flips, so every stored board
+ * can be served in 4 layouts. Both flips together is a 180 degree rotation.
+ */
+const int BOARD_FLIP_HORIZONTAL = 0b01;
+const int BOARD_FLIP_VERTICAL = 0b10;
+const int BOARD_TRANSFORM_COUNT = 4;
+
+/**
+ * Maps a cell index through a symmetry transform.
+ * Every transform is its own inverse, so this works in both directions.
+ * @param cell The cell index (x + y * 30)
+ * @param transform The transform ID (0 - 3)
+ * @return The transformed cell index
+ */
+int transformCell(int cell, int transform);
+
+/**
+ * Reads the nibble for a cell out of an encoded pool board
+ * 0x01: mine
+ * 0x02: ok starting spot
+ * @param boardEntry The encoded board (ENCODED_BOARD_SIZE bytes)
+ * @param cell The cell index (x + y * 30)
+ * @return The nibble
+ */
+uint8_t readBoardNibble(const uint8_t *boardEntry, int cell);
+
+/**
+ * Fills in the numbered tiles of a board that only has its mines placed
+ * @param board The board, 9 for mines and 0 everywhere else
+ */
+void fillBoardNumbers(uint8_t *board);
+
+/**
+ * Labels the openings of a board: connected areas of empty tiles, which reveal together
+ * @param board The unpacked board (0-8: adjacent mines, 9: mine)
+ * @param openings Set to the opening of every empty tile (0, 1, ...), -1 for the rest (30 * 13 entries)
+ * @return The number of openings
+ */
+int findOpenings(const uint8_t *board, int16_t *openings);
+
+/**
+ * Counts the board's 3BV: the minimum number of reveals needed to clear it.
+ * Every opening (connected area of empty tiles) is one, plus every numbered tile not touching an opening.
+ * @param board The unpacked board (0-8: adjacent mines, 9: mine)
+ * @return The 3BV
+ */
+int countBBBV(const uint8_t *board);
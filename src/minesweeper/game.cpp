@@ -1,14 +1,72 @@
 #include "game.h"
 
-std::function<int()> randUint8 = std::bind(std::uniform_int_distribution<int>(0, 255), std::default_random_engine());
+static const char *SPRITE_PATHS[31] = {
+    "assets/compiled/tile0.sprite",
+    "assets/compiled/tile1.sprite",
+    "assets/compiled/tile2.sprite",
+    "assets/compiled/tile3.sprite",
+    "assets/compiled/tile4.sprite",
+    "assets/compiled/tile5.sprite",
+    "assets/compiled/tile6.sprite",
+    "assets/compiled/tile7.sprite",
+    "assets/compiled/tile8.sprite",
+    "assets/compiled/mine.sprite",
+    "assets/compiled/mine-exploded.sprite",
+    "assets/compiled/flag.sprite",
+    "assets/compiled/defused.sprite",
+    "assets/compiled/cursor.sprite",
+    "assets/compiled/unchecked.sprite",
+    "assets/compiled/top-tile.sprite",
+    "assets/compiled/state-normal.sprite",
+    "assets/compiled/state-loss.sprite",
+    "assets/compiled/state-victory.sprite",
+    "assets/compiled/7seg-empty.sprite",
+    "assets/compiled/7seg-0.sprite",
+    "assets/compiled/7seg-1.sprite",
+    "assets/compiled/7seg-2.sprite",
+    "assets/compiled/7seg-3.sprite",
+    "assets/compiled/7seg-4.sprite",
+    "assets/compiled/7seg-5.sprite",
+    "assets/compiled/7seg-6.sprite",
+    "assets/compiled/7seg-7.sprite",
+    "assets/compiled/7seg-8.sprite",
+    "assets/compiled/7seg-9.sprite",
+    "assets/compiled/7seg-neg.sprite"};
+
+// everything an untouched board draws: cursor, unrevealed tile, topbar, neutral smiley, counters
+static const int BOARD_SPRITES[] = {13, 14, 15, 16, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29};
+
+// only needed once the player has done something
+static const int OTHER_SPRITES[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 17, 18, 30};
+
+static bool stageReady(const std::shared_future<void> &stage)
+{
+  return stage.valid() && stage.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static void waitForStage(const std::shared_future<void> &stage)
+{
+  if (stage.valid())
+    stage.wait();
+}
 
 MinesweeperGame::MinesweeperGame()
 {
-  this->sprites = new Sprite[30];
+  // zeroed, so sprites that never load (initHeadless) are safe to free
+  this->sprites = new Sprite[31]();
+  this->palette = createPalette();
   this->board = new uint8_t[30 * 13];
   this->boardState = new uint8_t[30 * 13];
   this->boardPoolSize = 0;
   this->boardPool = nullptr;
+  this->ownsBoardPool = true;
+  this->cellOrder = new uint16_t[30 * 13];
+  this->cellSlot = new uint16_t[30 * 13];
+  for (int i = 0; i < 30 * 13; i++)
+  {
+    this->cellOrder[i] = i;
+    this->cellSlot[i] = i;
+  }
   this->hasFirstMove = false;
   this->initizalized = false;
   this->gameState = 0;
@@ -17,29 +75,118 @@ MinesweeperGame::MinesweeperGame()
   this->endTime = time(NULL);
   this->cursorX = 0;
   this->cursorY = 0;
+  this->resultStore = nullptr;
+  this->currentGame = {RESULT_NO_POOL_INDEX, 0, 0, 0, 0, 0, 0, 0};
+  this->playStart = std::chrono::steady_clock::now();
 }
 
 MinesweeperGame::~MinesweeperGame()
 {
-  for (int i = 0; i < 30; i++)
+  // the loaders write into the arrays below
+  this->waitForLoad();
+
+  for (int i = 0; i < 31; i++)
   {
-    delete[] this->sprites[i].pixels;
+    freeSprite(&this->sprites[i]);
   }
   delete[] this->sprites;
-  delete[] this->boardPool;
+  freePalette(this->palette);
+  if (this->ownsBoardPool)
+    delete[] this->boardPool;
   delete[] this->board;
   delete[] this->boardState;
+  delete[] this->cellOrder;
+  delete[] this->cellSlot;
 }
 
 void MinesweeperGame::init()
 {
-  this->loadSprites();
-  this->loadBoardPool();
   this->generateFakeBoard();
   std::fill(this->boardState, this->boardState + 30 * 13, 0);
+
+  this->boardSpritesLoaded = std::async(std::launch::async, [this]()
+                                        { this->loadSprites(BOARD_SPRITES, sizeof(BOARD_SPRITES) / sizeof(int)); })
+                                 .share();
+
+  // queued behind the board sprites so they get the disk first
+  std::shared_future<void> boardSprites = this->boardSpritesLoaded;
+  this->spritesLoaded = std::async(std::launch::async, [this, boardSprites]()
+                                   {
+                                     boardSprites.wait();
+                                     this->loadSprites(OTHER_SPRITES, sizeof(OTHER_SPRITES) / sizeof(int)); })
+                            .share();
+
+  this->boardPoolLoaded = std::async(std::launch::async, [this]()
+                                     { this->loadBoardPool(); })
+                              .share();
+
+  this->initizalized = true;
+}
+
+void MinesweeperGame::initHeadless(MinesweeperGame *poolSource)
+{
+  this->generateFakeBoard();
+  std::fill(this->boardState, this->boardState + 30 * 13, 0);
+
+  // picked up when the first reveal waits for it, no thread or copy of its own
+  std::shared_future<void> sourceLoaded = poolSource->boardPoolLoaded;
+  this->ownsBoardPool = false;
+  this->boardPoolLoaded = std::async(std::launch::deferred, [this, poolSource, sourceLoaded]()
+                                     {
+                                       waitForStage(sourceLoaded);
+                                       this->boardPoolSize = poolSource->boardPoolSize;
+                                       this->boardPool = poolSource->boardPool; })
+                              .share();
+
+  this->initizalized = true;
+}
+
+void MinesweeperGame::initHeadless()
+{
+  this->generateFakeBoard();
+  std::fill(this->boardState, this->boardState + 30 * 13, 0);
+
+  this->boardPoolLoaded = std::async(std::launch::async, [this]()
+                                     { this->loadBoardPool(); })
+                              .share();
+
   this->initizalized = true;
 }
 
+bool MinesweeperGame::isReady()
+{
+  return this->initizalized && stageReady(this->boardSpritesLoaded);
+}
+
+void MinesweeperGame::waitForLoad()
+{
+  waitForStage(this->boardSpritesLoaded);
+  waitForStage(this->spritesLoaded);
+  waitForStage(this->boardPoolLoaded);
+}
+
+void MinesweeperGame::seed(uint64_t seed)
+{
+  this->random.seed(seed);
+}
+
+void MinesweeperGame::setPaletteFilter(uint32_t (*filter)(uint32_t))
+{
+  waitForStage(this->boardSpritesLoaded);
+  waitForStage(this->spritesLoaded);
+
+  applyPaletteFilter(this->palette, filter);
+
+  // composites and shrunk sprites were blended from the old colors
+  this->displayEngine.clearCompositeCache();
+  this->displayEngine.clearScaledCache();
+}
+
+void MinesweeperGame::setResultStore(ResultStore *store)
+{
+  this->resultStore = store;
+}
+
 void MinesweeperGame::moveCursor(int x, int y)
 {
   // clamp cursor to (0, 0) - (29, 12)
@@ -57,6 +204,9 @@ void MinesweeperGame::moveCursor(int x, int y)
 
 void MinesweeperGame::flag()
 {
+  // the flag and counter sprites load in the background
+  waitForStage(this->spritesLoaded);
+
   if (this->gameState != 0)
     return;
 
@@ -66,6 +216,8 @@ void MinesweeperGame::flag()
   if (state & 0b10000000)
     return;
 
+  this->currentGame.flags++;
+
   // toggle flag
   if (state & 0b01000000)
   {
@@ -80,18 +232,21 @@ void MinesweeperGame::flag()
 
   if (this->hasWon())
   {
-    this->revealAllMines();
-    this->gameState = 1;
-    this->endTime = time(NULL);
+    this->endGame(1);
   }
 }
 
 void MinesweeperGame::reveal()
 {
+  // the tile sprites load in the background
+  waitForStage(this->spritesLoaded);
+
   // first move is always safe
   if (!this->hasFirstMove)
   {
+    waitForStage(this->boardPoolLoaded);
     this->hasFirstMove = true;
+    this->currentGame.firstClick = this->cursorX + this->cursorY * 30;
     this->generateBoard(this->cursorX, this->cursorY);
   }
 
@@ -108,12 +263,12 @@ void MinesweeperGame::reveal()
   if (state & 0b01000000)
     return;
 
+  this->currentGame.reveals++;
+
   // mine
   if (this->board[this->cursorX + this->cursorY * 30] == 9)
   {
-    this->revealAllMines();
-    this->gameState = 2;
-    this->endTime = time(NULL);
+    this->endGame(2);
     return;
   }
 
@@ -121,9 +276,7 @@ void MinesweeperGame::reveal()
 
   if (this->hasWon())
   {
-    this->revealAllMines();
-    this->gameState = 1;
-    this->endTime = time(NULL);
+    this->endGame(1);
   }
 }
 
@@ -134,79 +287,155 @@ void MinesweeperGame::reset()
   this->endTime = time(NULL);
   this->gameState = 0;
   this->hasFirstMove = false;
+  this->currentGame = {RESULT_NO_POOL_INDEX, 0, 0, 0, 0, 0, 0, 0};
+  this->playStart = std::chrono::steady_clock::now();
   this->generateFakeBoard();
   std::fill(this->boardState, this->boardState + 30 * 13, 0);
 }
 
+Sprite *MinesweeperGame::getSprite(int id)
+{
+  return &this->sprites[id];
+}
+
+Sprite *MinesweeperGame::sizedSprite(Sprite *sprite, int scale, int shrink)
+{
+  if (shrink > 1)
+    return this->displayEngine.getShrunk(sprite, shrink);
+
+  return this->displayEngine.getScaled(sprite, scale);
+}
+
+void MinesweeperGame::snapshot(GameSnapshot *snapshot)
+{
+  std::copy(this->board, this->board + 30 * 13, snapshot->board);
+  std::copy(this->boardState, this->boardState + 30 * 13, snapshot->boardState);
+  snapshot->cursorX = this->cursorX;
+  snapshot->cursorY = this->cursorY;
+  snapshot->minesRemaining = this->minesRemaining;
+  snapshot->gameState = this->gameState;
+  snapshot->startTime = this->startTime;
+  snapshot->endTime = this->endTime;
+}
+
 void MinesweeperGame::render(uint32_t *pixels, uint16_t width, uint16_t height)
 {
-  if (!this->initizalized)
+  this->snapshot(&this->renderState);
+  this->render(&this->renderState, pixels, width, height);
+}
+
+void MinesweeperGame::render(const GameSnapshot *snapshot, uint32_t *pixels, uint16_t width, uint16_t height)
+{
+  // draw nothing until the board can be drawn
+  if (!this->isReady())
+  {
+    std::fill(pixels, pixels + width * height, 0xFFFFFFFF);
     return;
+  }
 
   // TODO: We could do this the smart way, simply shuffling sprites around
   //       instead of re-rendering everything every frame.
 
   this->displayEngine.clearSprites();
 
+  // the layout is designed for 480x240 (the VEX Brain),
+  // bigger targets get it scaled up by a whole number and centered
+  int scale = std::max(1, std::min(width / 480, height / 240));
+  int gridX = (width - 480 * scale) / 2;
+  int gridY = 32 * scale + (height - 240 * scale) / 2;
+
+  this->layoutSprites(snapshot, width, scale, 1, gridX, gridY, {0, 0, width, height});
+  this->displayEngine.renderSprites(pixels, width, height);
+}
+
+void MinesweeperGame::renderShrunk(const GameSnapshot *snapshot, uint32_t *pixels, int shrink, SpriteRect clip)
+{
+  int width = 480 / shrink;
+  int height = 240 / shrink;
+  if (!this->isReady())
+  {
+    std::fill(pixels, pixels + width * height, 0xFFFFFFFF);
+    return;
+  }
+
+  this->displayEngine.clearSprites();
+  this->layoutSprites(snapshot, width, 1, shrink, 0, 32 / shrink, clip);
+  this->displayEngine.renderSprites(pixels, width, height, clip);
+}
+
+SpriteRect MinesweeperGame::timerRect(int shrink)
+{
+  return {(480 - 48) / shrink, 0, 48 / shrink, 32 / shrink};
+}
+
+void MinesweeperGame::layoutSprites(const GameSnapshot *snapshot, uint16_t width, int scale, int shrink, int gridX, int gridY, SpriteRect clip)
+{
+  // a length of the 480x240 layout on the target
+  auto size = [scale, shrink](int length)
+  { return length * scale / shrink; };
+
   // topbar
 
   // background
-  for (int x = 0; x <= 480 - 32; x += 32)
+  for (int x = 0; x < width; x += size(32))
   {
-    this->displayEngine.addSprite(&this->sprites[15], x, 0, 1);
+    this->displayEngine.addSprite(this->sizedSprite(&this->sprites[15], scale, shrink), x, 0, 1);
   }
 
   // smiley
   int smileyID = 16;
-  if (this->gameState == 1)
+  if (snapshot->gameState == 1)
   {
     smileyID = 18;
   }
-  else if (this->gameState == 2)
+  else if (snapshot->gameState == 2)
   {
     smileyID = 17;
   }
-  this->displayEngine.addSprite(&this->sprites[smileyID], 480 / 2 - 16, 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[smileyID], scale, shrink), width / 2 - size(16), 0, 2);
 
   // timer
   time_t currentTime = time(NULL);
-  int timeElapsed = this->gameState != 0 ? this->endTime - this->startTime : currentTime - this->startTime;
+  int timeElapsed = snapshot->gameState != 0 ? snapshot->endTime - snapshot->startTime : currentTime - snapshot->startTime;
 
   int time100 = timeElapsed / 100;
   int time10 = (timeElapsed / 10) % 10;
   int time1 = timeElapsed % 10;
 
-  this->displayEngine.addSprite(&this->sprites[20 + time100], 480 - 48, 0, 2);
-  this->displayEngine.addSprite(&this->sprites[20 + time10], 480 - 32, 0, 2);
-  this->displayEngine.addSprite(&this->sprites[20 + time1], 480 - 16, 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[20 + time100], scale, shrink), width - size(48), 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[20 + time10], scale, shrink), width - size(32), 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[20 + time1], scale, shrink), width - size(16), 0, 2);
 
   // mines remaining
-  int mines10 = (this->minesRemaining / 10) % 10;
-  int mines1 = this->minesRemaining % 10;
+  int mines10 = (snapshot->minesRemaining / 10) % 10;
+  int mines1 = snapshot->minesRemaining % 10;
 
   // since we actually only have 80 mines, this one is special
   int mines100 = 19;
-  if (this->minesRemaining < 0)
+  if (snapshot->minesRemaining < 0)
   {
     mines100 = 30;
-    mines10 = (-this->minesRemaining / 10) % 10;
-    mines1 = -this->minesRemaining % 10;
+    mines10 = (-snapshot->minesRemaining / 10) % 10;
+    mines1 = -snapshot->minesRemaining % 10;
   }
 
-  this->displayEngine.addSprite(&this->sprites[mines100], 0, 0, 2);
-  this->displayEngine.addSprite(&this->sprites[20 + mines10], 16, 0, 2);
-  this->displayEngine.addSprite(&this->sprites[20 + mines1], 32, 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[mines100], scale, shrink), 0, 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[20 + mines10], scale, shrink), size(16), 0, 2);
+  this->displayEngine.addSprite(this->sizedSprite(&this->sprites[20 + mines1], scale, shrink), size(32), 0, 2);
+
+  // the grid, skipped when only the top bar is redrawn
+  if (clip.y + clip.height <= gridY)
+    return;
 
-  // the grid
   for (int x = 0; x < 30; x++)
   {
     for (int y = 0; y < 13; y++)
     {
-      uint8_t state = this->boardState[x + y * 30];
+      uint8_t state = snapshot->boardState[x + y * 30];
       bool revealed = state & 0b10000000;
       bool flagged = state & 0b01000000;
 
-      uint8_t tile = this->board[x + y * 30];
+      uint8_t tile = snapshot->board[x + y * 30];
       bool isMine = tile == 9;
 
       int baseSpriteID = 0;
@@ -215,7 +444,7 @@ void MinesweeperGame::render(uint32_t *pixels, uint16_t width, uint16_t height)
         if (isMine)
         {
           // has everything exploded yet?
-          if (this->gameState == 2 && !flagged)
+          if (snapshot->gameState == 2 && !flagged)
           {
             baseSpriteID = 10;
           }
@@ -239,7 +468,7 @@ void MinesweeperGame::render(uint32_t *pixels, uint16_t width, uint16_t height)
       if (flagged)
       {
         // has everything exploded yet?
-        if (this->gameState != 0 && isMine)
+        if (snapshot->gameState != 0 && isMine)
         {
           overlaySpriteID = 12;
         }
@@ -248,56 +477,35 @@ void MinesweeperGame::render(uint32_t *pixels, uint16_t width, uint16_t height)
           overlaySpriteID = 11;
         }
       }
-      int xPixel = x * 16;
-      int yPixel = y * 16 + 32;
+      int xPixel = gridX + x * size(16);
+      int yPixel = gridY + y * size(16);
 
-      this->displayEngine.addSprite(&this->sprites[baseSpriteID], xPixel, yPixel, 1);
+      // stack the base tile, overlay and cursor, and draw them as one pre-blended sprite
+      SpriteLayer layers[3];
+      int layerCount = 0;
+      layers[layerCount++] = {&this->sprites[baseSpriteID], 0, 0};
       if (overlaySpriteID != -1)
       {
-        this->displayEngine.addSprite(&this->sprites[overlaySpriteID], xPixel, yPixel, 2);
+        layers[layerCount++] = {&this->sprites[overlaySpriteID], 0, 0};
       }
+      if (x == snapshot->cursorX && y == snapshot->cursorY)
+      {
+        layers[layerCount++] = {&this->sprites[13], 0, 0};
+      }
+
+      Sprite *cell = layerCount == 1 ? layers[0].sprite : this->displayEngine.getComposite(layers, layerCount);
+      this->displayEngine.addSprite(this->sizedSprite(cell, scale, shrink), xPixel, yPixel, 1);
     }
   }
-
-  // add the cursor
-  this->displayEngine.addSprite(&this->sprites[13], this->cursorX * 16, this->cursorY * 16 + 32, 3);
-
-  this->displayEngine.renderSprites(pixels, width, height);
 }
 
-void MinesweeperGame::loadSprites()
-{
-  this->sprites[0] = loadSprite("assets/compiled/tile0.sprite");
-  this->sprites[1] = loadSprite("assets/compiled/tile1.sprite");
-  this->sprites[2] = loadSprite("assets/compiled/tile2.sprite");
-  this->sprites[3] = loadSprite("assets/compiled/tile3.sprite");
-  this->sprites[4] = loadSprite("assets/compiled/tile4.sprite");
-  this->sprites[5] = loadSprite("assets/compiled/tile5.sprite");
-  this->sprites[6] = loadSprite("assets/compiled/tile6.sprite");
-  this->sprites[7] = loadSprite("assets/compiled/tile7.sprite");
-  this->sprites[8] = loadSprite("assets/compiled/tile8.sprite");
-  this->sprites[9] = loadSprite("assets/compiled/mine.sprite");
-  this->sprites[10] = loadSprite("assets/compiled/mine-exploded.sprite");
-  this->sprites[11] = loadSprite("assets/compiled/flag.sprite");
-  this->sprites[12] = loadSprite("assets/compiled/defused.sprite");
-  this->sprites[13] = loadSprite("assets/compiled/cursor.sprite");
-  this->sprites[14] = loadSprite("assets/compiled/unchecked.sprite");
-  this->sprites[15] = loadSprite("assets/compiled/top-tile.sprite");
-  this->sprites[16] = loadSprite("assets/compiled/state-normal.sprite");
-  this->sprites[17] = loadSprite("assets/compiled/state-loss.sprite");
-  this->sprites[18] = loadSprite("assets/compiled/state-victory.sprite");
-  this->sprites[19] = loadSprite("assets/compiled/7seg-empty.sprite");
-  this->sprites[20] = loadSprite("assets/compiled/7seg-0.sprite");
-  this->sprites[21] = loadSprite("assets/compiled/7seg-1.sprite");
-  this->sprites[22] = loadSprite("assets/compiled/7seg-2.sprite");
-  this->sprites[23] = loadSprite("assets/compiled/7seg-3.sprite");
-  this->sprites[24] = loadSprite("assets/compiled/7seg-4.sprite");
-  this->sprites[25] = loadSprite("assets/compiled/7seg-5.sprite");
-  this->sprites[26] = loadSprite("assets/compiled/7seg-6.sprite");
-  this->sprites[27] = loadSprite("assets/compiled/7seg-7.sprite");
-  this->sprites[28] = loadSprite("assets/compiled/7seg-8.sprite");
-  this->sprites[29] = loadSprite("assets/compiled/7seg-9.sprite");
-  this->sprites[30] = loadSprite("assets/compiled/7seg-neg.sprite");
+void MinesweeperGame::loadSprites(const int *ids, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    // the stages load one after another, so they never add to the palette at the same time
+    this->sprites[ids[i]] = loadSprite(SPRITE_PATHS[ids[i]], this->palette);
+  }
 }
 
 void MinesweeperGame::loadBoardPool()
@@ -308,13 +516,13 @@ void MinesweeperGame::loadBoardPool()
   {
     std::cout << "File not found: assets/compiled/boards.bin" << std::endl;
 
-    // this will cause a crash, but it's better than silently failing
+    // boards will be generated on-device instead
     return;
   }
 
   file.read((char *)&this->boardPoolSize, 2);
-  this->boardPool = new uint8_t[this->boardPoolSize * (15 * 13)];
-  file.read((char *)this->boardPool, this->boardPoolSize * 15 * 13);
+  this->boardPool = new uint8_t[this->boardPoolSize * ENCODED_BOARD_SIZE];
+  file.read((char *)this->boardPool, this->boardPoolSize * ENCODED_BOARD_SIZE);
   file.close();
 }
 
@@ -332,80 +540,128 @@ void MinesweeperGame::generateFakeBoard()
 
 void MinesweeperGame::generateBoard(int firstX, int firstY)
 {
-  static int nextBoard = 0;
+  this->currentGame.poolIndex = RESULT_NO_POOL_INDEX;
+  this->currentGame.transform = 0;
+
+  if (this->boardPoolSize == 0)
+  {
+    this->generateRandomBoard(firstX, firstY);
+    return;
+  }
+
+  // every pool entry can be served under each symmetry transform,
+  // so we walk a virtual pool that is BOARD_TRANSFORM_COUNT times larger.
+  // the transform changes slowest, so the whole pool is played before
+  // any board is repeated (mirrored)
+  int virtualPoolSize = this->boardPoolSize * BOARD_TRANSFORM_COUNT;
+
+  // start somewhere random in the pool so every session is different
+  static int nextBoard = -1;
+  if (nextBoard < 0 || nextBoard >= virtualPoolSize)
+    nextBoard = this->random.nextBounded(virtualPoolSize);
 
   // this finds a board where the first move is safe
-  int moveIndex = firstX + firstY * 30;
+  for (int tries = 0; tries < virtualPoolSize; tries++)
+  {
+    int index = nextBoard % this->boardPoolSize;
+    int transform = nextBoard / this->boardPoolSize;
+    nextBoard = (nextBoard + 1) % virtualPoolSize;
+
+    if (this->loadPoolBoard(index, transform, firstX, firstY))
+    {
+      this->currentGame.poolIndex = index;
+      this->currentGame.transform = transform;
+      return;
+    }
+  }
 
-  while (true)
+  // no board in the pool has a safe start here
+  this->generateRandomBoard(firstX, firstY);
+}
+
+bool MinesweeperGame::loadPoolBoard(int index, int transform, int firstX, int firstY)
+{
+  // create a pointer to the start of the board
+  // its 2 tiles per byte, so its (30 / 2) * 13
+  uint8_t *boardEntry = this->boardPool + index * ENCODED_BOARD_SIZE;
+
+  // look at the nibble containing the first move, mapped back into the stored board
+  // if it is 2, it's ok
+  if (!(readBoardNibble(boardEntry, transformCell(firstX + firstY * 30, transform)) & 0x02))
+    return false;
+
+  // unpack the board, applying the transform as we go
+  for (int i = 0; i < 30 * 13; i++)
   {
-    // create a pointer to the start of the board
-    // its 2 tiles per byte, so its (30 / 2) * 13
-    uint8_t *boardEntry = this->boardPool + nextBoard * 15 * 13;
+    bool isMine = readBoardNibble(boardEntry, transformCell(i, transform)) & 0x01;
+    this->board[i] = isMine ? 9 : 0;
+  }
+
+  fillBoardNumbers(this->board);
+
+  return true;
+}
 
-    // look at the specific nibble containing the first move
-    uint8_t nibble = boardEntry[moveIndex / 2];
+void MinesweeperGame::generateRandomBoard(int firstX, int firstY)
+{
+  int available = 30 * 13;
 
-    if ((moveIndex % 2) == 0)
+  // move the first move and its neighbors to the end of the permutation
+  // so the shuffle below can never pick them
+  for (int dx = -1; dx <= 1; dx++)
+  {
+    for (int dy = -1; dy <= 1; dy++)
     {
-      nibble = nibble >> 4;
+      int x = firstX + dx;
+      int y = firstY + dy;
+      if (x < 0 || x >= 30 || y < 0 || y >= 13)
+        continue;
+
+      available--;
+      this->swapCells(this->cellSlot[x + y * 30], available);
     }
+  }
 
-    // if it is 2, it's ok
-    if (nibble & 0x02)
-    {
-      // unpack the board
-      for (int i = 0; i < 15 * 13; i++)
-      {
-        uint8_t chunk = boardEntry[i];
-        bool isFirstMine = chunk & 0x10;
-        bool isSecondMine = chunk & 0x01;
+  std::fill(this->board, this->board + 30 * 13, 0);
 
-        if (isFirstMine)
-          this->board[i * 2] = 9;
-        else
-          this->board[i * 2] = 0;
+  // partial Fisher-Yates, the first MINE_COUNT slots become the mines
+  // the permutation is never reset, any starting order gives a uniform pick
+  for (int i = 0; i < MINE_COUNT; i++)
+  {
+    int j = i + this->random.nextBounded(available - i);
+    this->swapCells(i, j);
+    this->board[this->cellOrder[i]] = 9;
+  }
 
-        if (isSecondMine)
-          this->board[i * 2 + 1] = 9;
-        else
-          this->board[i * 2 + 1] = 0;
-      }
+  // fill in the numbered tiles
+  for (int i = 0; i < MINE_COUNT; i++)
+  {
+    int x = this->cellOrder[i] % 30;
+    int y = this->cellOrder[i] / 30;
 
-      // fill in the numbered tiles
-      for (int x = 0; x < 30; x++)
+    for (int dx = -1; dx <= 1; dx++)
+    {
+      for (int dy = -1; dy <= 1; dy++)
       {
-        for (int y = 0; y < 13; y++)
-        {
-          if (this->board[x + y * 30] == 9)
-            continue;
+        if (x + dx < 0 || x + dx >= 30 || y + dy < 0 || y + dy >= 13)
+          continue;
 
-          int count = 0;
-          for (int dx = -1; dx <= 1; dx++)
-          {
-            for (int dy = -1; dy <= 1; dy++)
-            {
-              if (x + dx >= 0 && x + dx < 30 && y + dy >= 0 && y + dy < 13)
-              {
-                if (this->board[x + dx + (y + dy) * 30] == 9)
-                {
-                  count++;
-                }
-              }
-            }
-          }
-          this->board[x + y * 30] = count;
-        }
+        uint8_t &tile = this->board[x + dx + (y + dy) * 30];
+        if (tile != 9)
+          tile++;
       }
-
-      break;
     }
-
-    nextBoard = (nextBoard + 1) % this->boardPoolSize;
   }
+}
 
-  // force the next board to be different
-  nextBoard = (nextBoard + 1) % this->boardPoolSize;
+void MinesweeperGame::swapCells(int slotA, int slotB)
+{
+  uint16_t cellA = this->cellOrder[slotA];
+  uint16_t cellB = this->cellOrder[slotB];
+  this->cellOrder[slotA] = cellB;
+  this->cellOrder[slotB] = cellA;
+  this->cellSlot[cellA] = slotB;
+  this->cellSlot[cellB] = slotA;
 }
 
 void MinesweeperGame::revealTile(int x, int y)
@@ -458,6 +714,21 @@ void MinesweeperGame::revealAllMines()
   }
 }
 
+void MinesweeperGame::endGame(int state)
+{
+  this->revealAllMines();
+  this->gameState = state;
+  this->endTime = time(NULL);
+
+  if (this->resultStore != nullptr)
+  {
+    this->currentGame.result = state;
+    this->currentGame.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->playStart).count();
+    this->currentGame.bbbv = countBBBV(this->board);
+    this->resultStore->append(this->currentGame);
+  }
+}
+
 bool MinesweeperGame::hasWon()
 {
   if (this->minesRemaining != 0)
@@ -1,12 +1,27 @@
 #pragma once
 #include "../spritelib/sprites.h"
+#include "random.h"
+#include "board.h"
+#include "../stats/results.h"
 #include <time.h>
-#include <random>
-#include <functional>
+#include <chrono>
+#include <future>
 
-extern std::function<int()> randUInt8;
-
-const int ENCODED_BOARD_SIZE = 195;
+/**
+ * Copy of everything render() needs, so a game can be drawn
+ * on another thread while it keeps being played
+ */
+struct GameSnapshot
+{
+  uint8_t board[30 * 13];
+  uint8_t boardState[30 * 13];
+  int cursorX;
+  int cursorY;
+  int minesRemaining;
+  int gameState;
+  time_t startTime;
+  time_t endTime;
+};
 
 /** Sprite ID list (WIP)
  * 0-8: number of adjacent mines tile
@@ -34,8 +49,52 @@ public:
   int cursorX;
   int cursorY;
 
+  /**
+   * Starts loading the game, and returns right away.
+   * The sprites needed to draw an untouched board load first, then the rest of the sprites.
+   * The board pool loads in parallel, and is only waited for by the first reveal().
+   */
   void init();
 
+  /**
+   * Starts loading only the board pool, for games that are played but never
+   * render themselves (e.g. boards shown by a GameMosaic, which draws them with its own sprites).
+   * @param [poolSource] An init()ed game to share the board pool of instead of loading another copy,
+   *                     it must outlive this game
+   */
+  void initHeadless(MinesweeperGame *poolSource);
+  void initHeadless();
+
+  /**
+   * Blocks until every asset has loaded
+   */
+  void waitForLoad();
+
+  /**
+   * @return true once render() can draw the board
+   */
+  bool isReady();
+
+  /**
+   * Seeds the board generator, useful for reproducible games
+   * @param seed The seed
+   */
+  void seed(uint64_t seed);
+
+  /**
+   * Recolors every sprite through the shared palette (themes, colorblind mode, etc.)
+   * Not thread safe: it rewrites colors a render thread reads,
+   * so while a ThreadedRuntime is running use ThreadedRuntime::setPaletteFilter instead.
+   * @param filter The color filter, nullptr restores the original colors
+   */
+  void setPaletteFilter(uint32_t (*filter)(uint32_t));
+
+  /**
+   * Appends every finished game to a result store
+   * @param store The open, writable store, nullptr stops recording
+   */
+  void setResultStore(ResultStore *store);
+
   void moveCursor(int x, int y);
   void flag();
   void reveal();
@@ -43,12 +102,67 @@ public:
 
   void render(uint32_t *pixels, uint16_t width, uint16_t height);
 
+  /**
+   * @param id The sprite ID (see the list above)
+   * @return The loaded sprite
+   */
+  Sprite *getSprite(int id);
+
+  /**
+   * Copies the current game state into a snapshot
+   * @param snapshot Where to write the state
+   */
+  void snapshot(GameSnapshot *snapshot);
+
+  /**
+   * Renders a snapshot instead of the live game state.
+   * Only touches the sprites and the display engine, so it is safe to call
+   * from a render thread while another thread plays the game.
+   * @param snapshot The game state to render
+   * @param pixels The pixel array to render to
+   * @param width The width of the pixel array
+   * @param height The height of the pixel array
+   */
+  void render(const GameSnapshot *snapshot, uint32_t *pixels, uint16_t width, uint16_t height);
+
+  /**
+   * Renders a snapshot shrunk to (480 / shrink) x (240 / shrink), from box-filtered copies of the sprites,
+   * so small previews (e.g. GameMosaic tiles) cost about as much as their size. Same threading rules as render().
+   * @param snapshot The game state to render
+   * @param pixels The pixel array to render to, (480 / shrink) * (240 / shrink) pixels
+   * @param shrink The reduction factor, 1, 2, 4, 8 or 16, so the 16 px sprites shrink to whole pixels
+   * @param clip Only redraw this part of the pixel array, the rest is left as-is
+   */
+  void renderShrunk(const GameSnapshot *snapshot, uint32_t *pixels, int shrink, SpriteRect clip);
+
+  /**
+   * @param shrink The reduction factor passed to renderShrunk
+   * @return Where renderShrunk draws the timer, for redrawing only that when just the time changed
+   */
+  SpriteRect timerRect(int shrink);
+
 private:
   SpriteEngine displayEngine;
   Sprite *sprites;
+  // shared by every indexed sprite, so a theme is one palette update
+  Palette *palette;
+
+  // scratch snapshot for render(pixels, width, height)
+  GameSnapshot renderState;
 
   uint16_t boardPoolSize;
   uint8_t *boardPool;
+  // false when the pool belongs to the game passed to initHeadless
+  bool ownsBoardPool;
+
+  Random random;
+
+  /**
+   * Permutation of all cell indices, used by generateRandomBoard
+   * cellSlot is its inverse (cell index -> position in cellOrder)
+   */
+  uint16_t *cellOrder;
+  uint16_t *cellSlot;
 
   bool hasFirstMove;
 
@@ -77,17 +191,77 @@ private:
   int gameState;
   bool initizalized;
 
-  void loadSprites();
+  // the result of the game in progress, filled in as it is played
+  ResultStore *resultStore;
+  GameResult currentGame;
+  std::chrono::steady_clock::time_point playStart;
+
+  // loading stages started by init()
+  std::shared_future<void> boardSpritesLoaded;
+  std::shared_future<void> spritesLoaded;
+  std::shared_future<void> boardPoolLoaded;
+
+  /**
+   * Loads some of the sprites
+   * @param ids The sprite IDs to load
+   * @param count The number of IDs
+   */
+  void loadSprites(const int *ids, int count);
 
   void loadBoardPool();
 
+  /**
+   * @param sprite The sprite
+   * @param scale The integer scale factor
+   * @param shrink The integer reduction factor, used instead of scale when above 1
+   * @return The sprite, resized through the display engine's caches
+   */
+  Sprite *sizedSprite(Sprite *sprite, int scale, int shrink);
+
+  /**
+   * Adds the sprites of a snapshot to the display engine, the 480x240 layout scaled by scale / shrink
+   * @param snapshot The game state
+   * @param width The width of the target
+   * @param scale The integer scale factor
+   * @param shrink The integer reduction factor
+   * @param gridX The left edge of the grid
+   * @param gridY The top edge of the grid
+   * @param clip The part of the target being redrawn, the grid is left out if it is above it
+   */
+  void layoutSprites(const GameSnapshot *snapshot, uint16_t width, int scale, int shrink, int gridX, int gridY, SpriteRect clip);
+
   void generateFakeBoard();
 
   void generateBoard(int firstX, int firstY);
 
+  /**
+   * Unpacks a board from the pool into board
+   * @param index The index of the board in the pool
+   * @param transform The symmetry transform to apply (0 - 3)
+   * @param firstX The x position of the first move
+   * @param firstY The y position of the first move
+   * @return false (and leaves board untouched) if the first move is not a safe start
+   */
+  bool loadPoolBoard(int index, int transform, int firstX, int firstY);
+
+  /**
+   * Fallback for when there is no board pool.
+   * Places the mines with a partial Fisher-Yates shuffle,
+   * keeping the 3x3 area around the first move clear. O(mines).
+   */
+  void generateRandomBoard(int firstX, int firstY);
+
+  void swapCells(int slotA, int slotB);
+
   void revealTile(int x, int y);
 
   void revealAllMines();
 
+  /**
+   * Ends the game, revealing the mines and recording the result
+   * @param state The new game state (1: win, 2: lose)
+   */
+  void endGame(int state);
+
   bool hasWon();
 };
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "mosaic.h"
+#include <algorithm>
+#include <cstring>
+
+// background around and between the tiles
+const uint32_t MOSAIC_BACKGROUND = 0xFF202020;
+
+static bool sameSnapshot(const GameSnapshot *a, const GameSnapshot *b)
+{
+  return memcmp(a->board, b->board, sizeof(a->board)) == 0 &&
+         memcmp(a->boardState, b->boardState, sizeof(a->boardState)) == 0 &&
+         a->cursorX == b->cursorX && a->cursorY == b->cursorY &&
+         a->minesRemaining == b->minesRemaining && a->gameState == b->gameState &&
+         a->startTime == b->startTime && a->endTime == b->endTime;
+}
+
+// the value the board's timer shows right now
+static int timerSeconds(const GameSnapshot *snapshot, time_t currentTime)
+{
+  return snapshot->gameState != 0 ? snapshot->endTime - snapshot->startTime : currentTime - snapshot->startTime;
+}
+
+GameMosaic::GameMosaic(MinesweeperGame *renderer)
+{
+  this->renderer = renderer;
+  this->width = 0;
+  this->height = 0;
+  this->shrink = 1;
+  this->columns = 0;
+  this->originX = 0;
+  this->originY = 0;
+}
+
+bool GameMosaic::setLayout(uint16_t width, uint16_t height, int boardCount)
+{
+  this->width = width;
+  this->height = height;
+  this->pixels.assign(width * height, MOSAIC_BACKGROUND);
+  this->tiles.assign(boardCount, Tile());
+
+  // the smallest reduction that fits every board, so tiles stay as big as possible.
+  // powers of two, so the 16 px sprites shrink to whole pixels (see MinesweeperGame::renderShrunk)
+  for (int shrink = 1; shrink <= 16; shrink *= 2)
+  {
+    int tileWidth = 480 / shrink;
+    int tileHeight = 240 / shrink;
+    int columns = width / tileWidth;
+    int rows = height / tileHeight;
+    if (columns * rows < boardCount)
+      continue;
+
+    // use as few rows as possible, and center the whole grid
+    rows = (boardCount + columns - 1) / columns;
+    this->shrink = shrink;
+    this->columns = columns;
+    this->originX = (width - columns * tileWidth) / 2;
+    this->originY = (height - rows * tileHeight) / 2;
+    this->scratch.resize(tileWidth * tileHeight);
+    return true;
+  }
+
+  this->tiles.clear();
+  return false;
+}
+
+void GameMosaic::updateBoard(int index, const GameSnapshot *snapshot)
+{
+  Tile &tile = this->tiles[index];
+  if (tile.hasState && sameSnapshot(&tile.latest, snapshot))
+    return;
+
+  tile.latest = *snapshot;
+  tile.hasState = true;
+  tile.changed = true;
+}
+
+int GameMosaic::render()
+{
+  // keep the tiles marked as changed until they can actually be drawn
+  if (!this->renderer->isReady())
+    return 0;
+
+  int tileWidth = 480 / this->shrink;
+  int tileHeight = 240 / this->shrink;
+  time_t currentTime = time(NULL);
+  int redrawn = 0;
+
+  for (size_t i = 0; i < this->tiles.size(); i++)
+  {
+    Tile &tile = this->tiles[i];
+    if (!tile.hasState)
+      continue;
+
+    // running games also change once a second, when the timer ticks
+    int seconds = timerSeconds(&tile.latest, currentTime);
+    if (!tile.changed && seconds == tile.drawnSeconds)
+      continue;
+
+    // a tick only redraws the timer digits
+    SpriteRect clip = {0, 0, tileWidth, tileHeight};
+    if (!tile.changed)
+      clip = this->renderer->timerRect(this->shrink);
+
+    this->renderer->renderShrunk(&tile.latest, this->scratch.data(), this->shrink, clip);
+
+    int x = this->originX + (i % this->columns) * tileWidth;
+    int y = this->originY + (i / this->columns) * tileHeight;
+    for (int row = clip.y; row < clip.y + clip.height; row++)
+    {
+      const uint32_t *source = this->scratch.data() + row * tileWidth + clip.x;
+      std::copy(source, source + clip.width, this->pixels.data() + (y + row) * this->width + x + clip.x);
+    }
+
+    tile.changed = false;
+    tile.drawnSeconds = seconds;
+    redrawn++;
+  }
+
+  return redrawn;
+}
+
+const uint32_t *GameMosaic::getPixels()
+{
+  return this->pixels.data();
+}
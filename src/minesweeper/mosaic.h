@@ -0,0 +1,73 @@
+#pragma once
+#include "game.h"
+#include <vector>
+
+/**
+ * Spectator view of many games at once, tiled into one framebuffer (kiosk walls, watching automated play)
+ * Every board is drawn through a single renderer game, so all tiles share one set of sprites and caches.
+ * The framebuffer is kept between frames and a tile is only redrawn when its state changed,
+ * or just its timer digits when only the time did. Tiles are drawn at their own size from shrunk sprites,
+ * so the cost of a frame follows the number of active boards and the tile size, not the number shown.
+ */
+class GameMosaic
+{
+public:
+  /**
+   * @param renderer An init()ed game, only used to draw the tiles
+   */
+  GameMosaic(MinesweeperGame *renderer);
+
+  /**
+   * Lays out the tiles, using the largest tile size (480x240 divided by 1, 2, 4, 8 or 16) that fits every board.
+   * Clears the framebuffer and forgets every board state.
+   * @param width The width of the framebuffer
+   * @param height The height of the framebuffer
+   * @param boardCount The number of boards to show
+   * @return false if the boards don't fit even at the smallest tile size
+   */
+  bool setLayout(uint16_t width, uint16_t height, int boardCount);
+
+  /**
+   * Stores the latest state of a board, it is drawn by the next render() if it changed
+   * @param index The board (0 - boardCount - 1)
+   * @param snapshot The state of the board
+   */
+  void updateBoard(int index, const GameSnapshot *snapshot);
+
+  /**
+   * Redraws the tiles whose state changed since they were last drawn
+   * @return The number of tiles redrawn
+   */
+  int render();
+
+  /**
+   * @return The framebuffer, width * height ARGB8888 pixels
+   */
+  const uint32_t *getPixels();
+
+private:
+  struct Tile
+  {
+    GameSnapshot latest;
+    bool hasState;
+    bool changed;
+    // the timer value the tile was last drawn with
+    int drawnSeconds;
+  };
+
+  MinesweeperGame *renderer;
+  uint16_t width;
+  uint16_t height;
+
+  // tiles are 480x240 divided by shrink, a power of two
+  int shrink;
+  int columns;
+  int originX;
+  int originY;
+
+  std::vector<Tile> tiles;
+  std::vector<uint32_t> pixels;
+
+  // one tile, rendered before it is copied into the framebuffer
+  std::vector<uint32_t> scratch;
+};
@@ -0,0 +1,96 @@
+#include "random.h"
+#include <chrono>
+#include <random>
+
+static uint64_t splitmix64(uint64_t &x)
+{
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+Random::Random()
+{
+  this->seedFromEntropy();
+}
+
+Random::Random(uint64_t seed)
+{
+  this->seed(seed);
+}
+
+void Random::seed(uint64_t seed)
+{
+  uint64_t a = splitmix64(seed);
+  uint64_t b = splitmix64(seed);
+  this->state[0] = (uint32_t)a;
+  this->state[1] = (uint32_t)(a >> 32);
+  this->state[2] = (uint32_t)b;
+  this->state[3] = (uint32_t)(b >> 32);
+}
+
+void Random::seedFromEntropy()
+{
+  uint64_t seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+  // random_device may throw or be deterministic on some platforms,
+  // the clock alone is still good enough for a game
+  try
+  {
+    std::random_device device;
+    seed ^= ((uint64_t)device() << 32) | device();
+  }
+  catch (...)
+  {
+  }
+
+  this->seed(seed);
+}
+
+void Random::jump()
+{
+  static const uint32_t JUMP[] = {0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b};
+  this->applyJump(JUMP);
+}
+
+void Random::longJump()
+{
+  static const uint32_t LONG_JUMP[] = {0xb523952e, 0x0b6f099f, 0xccf5a0ef, 0x1c580662};
+  this->applyJump(LONG_JUMP);
+}
+
+Random Random::split()
+{
+  Random stream = *this;
+  this->jump();
+  return stream;
+}
+
+void Random::applyJump(const uint32_t *table)
+{
+  uint32_t s0 = 0;
+  uint32_t s1 = 0;
+  uint32_t s2 = 0;
+  uint32_t s3 = 0;
+
+  for (int i = 0; i < 4; i++)
+  {
+    for (int b = 0; b < 32; b++)
+    {
+      if (table[i] & (1u << b))
+      {
+        s0 ^= this->state[0];
+        s1 ^= this->state[1];
+        s2 ^= this->state[2];
+        s3 ^= this->state[3];
+      }
+      this->next();
+    }
+  }
+
+  this->state[0] = s0;
+  this->state[1] = s1;
+  this->state[2] = s2;
+  this->state[3] = s3;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cinttypes>
+
+/**
+ * Small, fast, seedable PRNG (xoshiro128**)
+ * 32-bit state words so it stays cheap on the VEX Brain's ARM core.
+ * Streams can be split with jump() so several generators never overlap.
+ */
+class Random
+{
+public:
+  Random();
+  Random(uint64_t seed);
+
+  /**
+   * Re-seeds the generator. The seed is expanded with splitmix64,
+   * so any value (including 0) gives a usable state.
+   * @param seed The seed
+   */
+  void seed(uint64_t seed);
+
+  /**
+   * Seeds the generator from std::random_device and the clock
+   */
+  void seedFromEntropy();
+
+  /**
+   * @return The next 32 random bits
+   */
+  inline uint32_t next()
+  {
+    uint32_t result = rotl(this->state[1] * 5, 7) * 9;
+    uint32_t t = this->state[1] << 9;
+
+    this->state[2] ^= this->state[0];
+    this->state[3] ^= this->state[1];
+    this->state[1] ^= this->state[2];
+    this->state[0] ^= this->state[3];
+    this->state[2] ^= t;
+    this->state[3] = rotl(this->state[3], 11);
+
+    return result;
+  }
+
+  /**
+   * Returns a uniformly distributed value in [0, bound)
+   * Uses Lemire's multiply-shift method, so there is no modulo bias
+   * and (almost always) no division.
+   * @param bound The exclusive upper bound, must be > 0
+   * @return The random value
+   */
+  inline uint32_t nextBounded(uint32_t bound)
+  {
+    uint64_t m = (uint64_t)this->next() * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound)
+    {
+      uint32_t threshold = -bound % bound;
+      while (low < threshold)
+      {
+        m = (uint64_t)this->next() * bound;
+        low = (uint32_t)m;
+      }
+    }
+    return m >> 32;
+  }
+
+  /**
+   * @return A random byte
+   */
+  inline uint8_t nextUInt8()
+  {
+    return this->next() >> 24;
+  }
+
+  /**
+   * Advances the generator by 2^64 steps.
+   * Equivalent to 2^64 calls to next(), so streams separated by
+   * a jump can be used in parallel without overlapping.
+   */
+  void jump();
+
+  /**
+   * Advances the generator by 2^96 steps.
+   * Use this to hand out starting points for sets of jump() streams.
+   */
+  void longJump();
+
+  /**
+   * Creates an independent stream.
+   * The returned generator continues from the current state,
+   * and this generator jumps ahead past it.
+   * @return The new generator
+   */
+  Random split();
+
+private:
+  uint32_t state[4];
+
+  static inline uint32_t rotl(uint32_t x, int k)
+  {
+    return (x << k) | (x >> (32 - k));
+  }
+
+  void applyJump(const uint32_t *table);
+};
@@ -0,0 +1,145 @@
+#include "latency.h"
+#include <chrono>
+
+static const char *STAGE_NAMES[LATENCY_STAGE_COUNT] = {"queue", "render", "upload", "present", "total"};
+
+uint64_t traceNow()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyTag earliestTag(const LatencyTag &a, const LatencyTag &b)
+{
+  if (a.input == 0)
+    return b;
+  if (b.input == 0)
+    return a;
+  return a.input <= b.input ? a : b;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  this->reset();
+}
+
+void LatencyHistogram::record(uint64_t micros)
+{
+  this->buckets[bucketIndex(micros)]++;
+  this->count++;
+  if (micros > this->max)
+    this->max = micros;
+}
+
+void LatencyHistogram::reset()
+{
+  std::fill(this->buckets, this->buckets + BUCKET_COUNT, 0);
+  this->count = 0;
+  this->max = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile)
+{
+  if (this->count == 0)
+    return 0;
+
+  // the rank of the sample we want, 1-based
+  uint64_t rank = (uint64_t)(percentile / 100.0 * this->count + 0.5);
+  if (rank < 1)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++)
+  {
+    seen += this->buckets[i];
+    if (seen >= rank)
+      return std::min(bucketValue(i), this->max);
+  }
+
+  return this->max;
+}
+
+int LatencyHistogram::bucketIndex(uint64_t micros)
+{
+  if (micros < 8)
+    return micros;
+
+  int msb = 63 - __builtin_clzll(micros);
+  int sub = (micros >> (msb - 3)) & 0b111;
+  int index = (msb - 2) * 8 + sub;
+  return std::min(index, BUCKET_COUNT - 1);
+}
+
+uint64_t LatencyHistogram::bucketValue(int index)
+{
+  if (index < 8)
+    return index;
+
+  int msb = index / 8 + 2;
+  int sub = index % 8;
+  return (uint64_t)(8 + sub) << (msb - 3);
+}
+
+LatencyTracer::LatencyTracer(uint64_t dumpInterval)
+{
+  this->dumpInterval = dumpInterval;
+  this->lastDump = traceNow();
+  for (int i = 0; i < 3; i++)
+  {
+    this->overlayValues[i] = 0;
+  }
+}
+
+void LatencyTracer::record(const LatencyTag &tag)
+{
+  this->histograms[LATENCY_STAGE_QUEUE].record(tag.action - tag.input);
+  this->histograms[LATENCY_STAGE_RENDER].record(tag.render - tag.action);
+  this->histograms[LATENCY_STAGE_UPLOAD].record(tag.upload - tag.render);
+  this->histograms[LATENCY_STAGE_PRESENT].record(tag.present - tag.upload);
+  this->histograms[LATENCY_STAGE_TOTAL].record(tag.present - tag.input);
+}
+
+void LatencyTracer::tick()
+{
+  uint64_t now = traceNow();
+  if (now - this->lastDump < this->dumpInterval)
+    return;
+  this->lastDump = now;
+
+  LatencyHistogram &total = this->histograms[LATENCY_STAGE_TOTAL];
+  this->overlayValues[0] = total.percentile(50);
+  this->overlayValues[1] = total.percentile(99);
+  this->overlayValues[2] = total.max;
+
+  if (total.count > 0)
+  {
+    std::cout << "latency (us) over " << total.count << " inputs:" << std::endl;
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+      LatencyHistogram &histogram = this->histograms[i];
+      std::cout << "  " << STAGE_NAMES[i]
+                << " p50 " << histogram.percentile(50)
+                << " p99 " << histogram.percentile(99)
+                << " max " << histogram.max << std::endl;
+    }
+  }
+
+  for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+  {
+    this->histograms[i].reset();
+  }
+}
+
+void LatencyTracer::drawOverlay(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *digits, int scale)
+{
+  // between the mine counter and the smiley
+  int x = 56 * scale;
+
+  for (int i = 0; i < 3; i++)
+  {
+    int millis = std::min<uint64_t>(this->overlayValues[i] / 1000, 999);
+    drawSprite(pixels, width, height, &digits[millis / 100], x, 0, scale);
+    drawSprite(pixels, width, height, &digits[(millis / 10) % 10], x + 16 * scale, 0, scale);
+    drawSprite(pixels, width, height, &digits[millis % 10], x + 32 * scale, 0, scale);
+    x += 52 * scale;
+  }
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <cinttypes>
+#include "../spritelib/sprites.h"
+
+/**
+ * @return A monotonic timestamp in microseconds
+ */
+uint64_t traceNow();
+
+/**
+ * Timestamps (traceNow) of one input on its way to the screen
+ * 0 means the input has not reached that stage (or there is no input)
+ */
+struct LatencyTag
+{
+  // the input event happened
+  uint64_t input;
+  // the game acted on it
+  uint64_t action;
+  // a frame containing the result was rendered
+  uint64_t render;
+  // the frame was uploaded to the display
+  uint64_t upload;
+  // the frame was presented
+  uint64_t present;
+};
+
+/**
+ * Picks the tag of the earlier input, for when two tagged values are merged
+ * (e.g. a frame that was replaced before it was shown)
+ * @param a A tag
+ * @param b Another tag
+ * @return The tag with the earliest input, untraced tags lose
+ */
+LatencyTag earliestTag(const LatencyTag &a, const LatencyTag &b);
+
+enum LatencyStage
+{
+  LATENCY_STAGE_QUEUE,   // input -> action
+  LATENCY_STAGE_RENDER,  // action -> render
+  LATENCY_STAGE_UPLOAD,  // render -> upload
+  LATENCY_STAGE_PRESENT, // upload -> present
+  LATENCY_STAGE_TOTAL,   // input -> present
+  LATENCY_STAGE_COUNT
+};
+
+/**
+ * Log-linear histogram of microsecond durations
+ * Every power of 2 is split into 8 buckets, so values are kept within 12.5%
+ * up to ~16 seconds. Fixed size, recording never allocates.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(uint64_t micros);
+  void reset();
+
+  /**
+   * @param percentile The percentile (0 - 100)
+   * @return The lower bound of the bucket holding that percentile, in microseconds
+   */
+  uint64_t percentile(double percentile);
+
+  uint64_t count;
+  uint64_t max;
+
+private:
+  static const int BUCKET_COUNT = 184;
+  uint64_t buckets[BUCKET_COUNT];
+
+  static int bucketIndex(uint64_t micros);
+  static uint64_t bucketValue(int index);
+};
+
+/**
+ * Collects input-to-present latency per stage
+ * Record from one thread (the one presenting frames). The overlay
+ * summary is published through atomics, so any thread can draw it.
+ */
+class LatencyTracer
+{
+public:
+  /**
+   * @param dumpInterval How often tick() logs and resets the stats, in microseconds
+   */
+  LatencyTracer(uint64_t dumpInterval);
+
+  /**
+   * Records a fully presented input
+   * @param tag The timestamps of the input
+   */
+  void record(const LatencyTag &tag);
+
+  /**
+   * Logs the stats and starts a new interval, once every dumpInterval
+   */
+  void tick();
+
+  /**
+   * Draws p50, p99 and max of the total latency (in ms) into the top bar
+   * using the 7-segment digits.
+   * @param pixels The ARGB8888 frame
+   * @param width The width of the frame
+   * @param height The height of the frame
+   * @param digits The 7-segment sprites for 0 - 9, in order, unscaled
+   * @param scale The scale the game was rendered at, to line up with its top bar
+   */
+  void drawOverlay(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *digits, int scale);
+
+private:
+  LatencyHistogram histograms[LATENCY_STAGE_COUNT];
+  uint64_t dumpInterval;
+  uint64_t lastDump;
+
+  // p50, p99, max of the total latency over the last interval, in microseconds
+  std::atomic<uint64_t> overlayValues[3];
+};
@@ -0,0 +1,219 @@
+#include "runtime.h"
+#include <algorithm>
+#include <chrono>
+
+void applyInput(MinesweeperGame *game, GameInput input)
+{
+  switch (input.action)
+  {
+  case GAME_ACTION_MOVE:
+    game->moveCursor(input.dx, input.dy);
+    break;
+  case GAME_ACTION_REVEAL:
+    game->reveal();
+    break;
+  case GAME_ACTION_FLAG:
+    game->flag();
+    break;
+  case GAME_ACTION_RESET:
+    game->reset();
+    break;
+  }
+}
+
+ThreadedRuntime::ThreadedRuntime(MinesweeperGame *game, uint16_t width, uint16_t height, PixelFormat format, bool dither)
+{
+  this->game = game;
+  this->width = width;
+  this->height = height;
+  this->format = format;
+  this->dither = dither;
+  this->running = false;
+  this->overlayTracer = nullptr;
+  this->capture = nullptr;
+  this->captureInterval = 0;
+  this->nextCaptureTime = 0;
+  this->paletteFilter = nullptr;
+  this->paletteChanged = false;
+
+  for (int i = 0; i < 3; i++)
+  {
+    this->frames.buffer(i)->pixels.resize(width * height);
+  }
+}
+
+ThreadedRuntime::~ThreadedRuntime()
+{
+  this->stop();
+}
+
+void ThreadedRuntime::start()
+{
+  if (this->running)
+    return;
+
+  // every buffer starts out as the current state,
+  // and publishing one makes the renderer draw straight away
+  for (int i = 0; i < 3; i++)
+  {
+    this->game->snapshot(&this->snapshots.buffer(i)->state);
+    this->snapshots.buffer(i)->tag = LatencyTag();
+  }
+  this->snapshots.publish();
+
+  this->running = true;
+  this->simulationThread = std::thread(&ThreadedRuntime::simulationLoop, this);
+  this->renderThread = std::thread(&ThreadedRuntime::renderLoop, this);
+}
+
+void ThreadedRuntime::stop()
+{
+  if (!this->running)
+    return;
+
+  this->running = false;
+  this->simulationThread.join();
+  this->renderThread.join();
+}
+
+bool ThreadedRuntime::pushInput(GameInput input)
+{
+  return this->inputQueue.push(input);
+}
+
+const uint8_t *ThreadedRuntime::acquireFrame(LatencyTag *tag)
+{
+  if (!this->frames.acquire())
+    return nullptr;
+
+  RuntimeFrame *frame = this->frames.readBuffer();
+  if (tag != nullptr)
+    *tag = frame->tag;
+
+  return (const uint8_t *)frame->pixels.data();
+}
+
+const uint8_t *ThreadedRuntime::acquireFrame()
+{
+  return this->acquireFrame(nullptr);
+}
+
+void ThreadedRuntime::setLatencyOverlay(LatencyTracer *tracer)
+{
+  this->overlayTracer = tracer;
+}
+
+void ThreadedRuntime::setCapture(FrameCapture *capture, int fps)
+{
+  this->capture = capture;
+  this->captureInterval = 1000000 / std::max(1, fps);
+  this->captureFrame.resize(this->width * this->height);
+}
+
+void ThreadedRuntime::setPaletteFilter(uint32_t (*filter)(uint32_t))
+{
+  this->paletteFilter = filter;
+  this->paletteChanged = true;
+}
+
+void ThreadedRuntime::simulationLoop()
+{
+  while (this->running)
+  {
+    bool changed = false;
+    LatencyTag tag = LatencyTag();
+
+    GameInput input;
+    while (this->inputQueue.pop(&input))
+    {
+      applyInput(this->game, input);
+      changed = true;
+
+      // inputs applied together are traced by the earliest one
+      if (input.timestamp != 0 && tag.input == 0)
+        tag.input = input.timestamp;
+    }
+
+    if (!changed)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    if (tag.input != 0)
+      tag.action = traceNow();
+
+    RuntimeSnapshot *snapshot = this->snapshots.writeBuffer();
+    this->game->snapshot(&snapshot->state);
+
+    // a snapshot the renderer never saw keeps its input traced through this one
+    this->snapshots.publish([&](const RuntimeSnapshot *skipped)
+                            { snapshot->tag = skipped != nullptr ? earliestTag(skipped->tag, tag) : tag; });
+  }
+}
+
+void ThreadedRuntime::renderLoop()
+{
+  time_t lastRenderTime = 0;
+  // the scale MinesweeperGame::render picks for the frame size
+  int renderScale = std::max(1, std::min(this->width / 480, this->height / 240));
+
+  while (this->running)
+  {
+    bool fresh = this->snapshots.acquire();
+
+    // recolor between frames, nothing else touches the sprites
+    bool recolored = this->paletteChanged.exchange(false);
+    if (recolored)
+      this->game->setPaletteFilter(this->paletteFilter);
+
+    // the timer is the only thing that changes without a new snapshot
+    time_t currentTime = time(NULL);
+    if (!fresh && !recolored && currentTime == lastRenderTime)
+    {
+      this->captureTick();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    lastRenderTime = currentTime;
+
+    RuntimeSnapshot *snapshot = this->snapshots.readBuffer();
+    RuntimeFrame *frame = this->frames.writeBuffer();
+    uint32_t *pixels = frame->pixels.data();
+
+    this->game->render(&snapshot->state, pixels, this->width, this->height);
+    if (this->overlayTracer != nullptr && this->game->isReady())
+      this->overlayTracer->drawOverlay(pixels, this->width, this->height, this->game->getSprite(20), renderScale);
+
+    // the capture wants ARGB8888, so keep a copy from before the conversion
+    if (this->capture != nullptr)
+      std::copy(pixels, pixels + this->width * this->height, this->captureFrame.data());
+
+    convertPixels(pixels, (uint8_t *)pixels, this->width, this->height, this->format, this->dither);
+
+    // only the first frame showing an input carries its tag
+    LatencyTag tag = fresh ? snapshot->tag : LatencyTag();
+    if (tag.input != 0)
+      tag.render = traceNow();
+
+    // so does the next one, if that frame is replaced before it is presented
+    this->frames.publish([&](const RuntimeFrame *skipped)
+                         { frame->tag = skipped != nullptr ? earliestTag(skipped->tag, tag) : tag; });
+
+    this->captureTick();
+  }
+}
+
+void ThreadedRuntime::captureTick()
+{
+  if (this->capture == nullptr || !this->capture->isOpen())
+    return;
+
+  uint64_t now = traceNow();
+  if (now < this->nextCaptureTime)
+    return;
+
+  // keep to the frame rate, but don't try to catch up after a stall
+  this->nextCaptureTime = std::max(this->nextCaptureTime + this->captureInterval, now);
+  this->capture->submitFrame(this->captureFrame.data(), false);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../minesweeper/game.h"
+#include "../capture/capture.h"
+#include "../spritelib/pixelformat.h"
+#include "latency.h"
+#include "spscqueue.h"
+#include "triplebuffer.h"
+
+enum GameAction
+{
+  GAME_ACTION_MOVE,
+  GAME_ACTION_REVEAL,
+  GAME_ACTION_FLAG,
+  GAME_ACTION_RESET
+};
+
+struct GameInput
+{
+  GameAction action;
+  // cursor movement, only used by GAME_ACTION_MOVE
+  int8_t dx;
+  int8_t dy;
+  // when the input happened (traceNow), 0 if it is not traced
+  uint64_t timestamp;
+};
+
+struct RuntimeSnapshot
+{
+  GameSnapshot state;
+  // the earliest traced input in this snapshot (input and action set)
+  LatencyTag tag;
+};
+
+struct RuntimeFrame
+{
+  std::vector<uint32_t> pixels;
+  // the earliest traced input in this frame (up to render set)
+  LatencyTag tag;
+};
+
+/**
+ * Applies an input to a game
+ * @param game The game
+ * @param input The input
+ */
+void applyInput(MinesweeperGame *game, GameInput input);
+
+/**
+ * Runs a game on two worker threads:
+ * - simulation: drains the input queue and publishes game snapshots
+ * - renderer: renders the newest snapshot into triple-buffered frames
+ * The presenting thread (the one that owns the window) only pushes input
+ * and picks up finished frames, so neither side ever waits on the other.
+ */
+class ThreadedRuntime
+{
+public:
+  /**
+   * @param game The game to run, must already be initialized
+   * @param width The width of the frames
+   * @param height The height of the frames
+   * @param format The pixel format of the frames
+   * @param dither Whether to dither when converting frames
+   */
+  ThreadedRuntime(MinesweeperGame *game, uint16_t width, uint16_t height, PixelFormat format, bool dither);
+  ~ThreadedRuntime();
+
+  void start();
+  void stop();
+
+  /**
+   * Queues an input for the simulation thread (presenting thread only)
+   * @param input The input
+   * @return false if the queue is full and the input was dropped
+   */
+  bool pushInput(GameInput input);
+
+  /**
+   * Takes the newest finished frame (presenting thread only)
+   * The frame stays valid until the next call.
+   * @param [tag] Where to write the latency tag of the frame
+   * @return The frame in the requested pixel format, or nullptr if there is no new frame
+   */
+  const uint8_t *acquireFrame(LatencyTag *tag);
+  const uint8_t *acquireFrame();
+
+  /**
+   * Makes the render thread draw the latency overlay on every frame
+   * Call before start().
+   * @param tracer The tracer to draw
+   */
+  void setLatencyOverlay(LatencyTracer *tracer);
+
+  /**
+   * Makes the render thread stream frames to a capture, at a steady frame rate
+   * (the last frame is repeated while nothing changes). Frames are dropped rather than
+   * holding up rendering. Call before start().
+   * @param capture The open capture, with the same size as the frames
+   * @param fps The frame rate the capture was opened with
+   */
+  void setCapture(FrameCapture *capture, int fps);
+
+  /**
+   * Recolors the game's sprites (see MinesweeperGame::setPaletteFilter) on the render thread,
+   * between two frames, so it never races a render (presenting thread only)
+   * @param filter The color filter, nullptr restores the original colors
+   */
+  void setPaletteFilter(uint32_t (*filter)(uint32_t));
+
+private:
+  MinesweeperGame *game;
+  uint16_t width;
+  uint16_t height;
+  PixelFormat format;
+  bool dither;
+
+  std::atomic<bool> running;
+  std::thread simulationThread;
+  std::thread renderThread;
+
+  SpscQueue<GameInput, 256> inputQueue;
+  TripleBuffer<RuntimeSnapshot> snapshots;
+  TripleBuffer<RuntimeFrame> frames;
+
+  LatencyTracer *overlayTracer;
+
+  FrameCapture *capture;
+  uint64_t captureInterval;
+  uint64_t nextCaptureTime;
+  // the last rendered frame, before it is converted to the target format
+  std::vector<uint32_t> captureFrame;
+
+  // handed to the render thread by setPaletteFilter
+  std::atomic<uint32_t (*)(uint32_t)> paletteFilter;
+  std::atomic<bool> paletteChanged;
+
+  void simulationLoop();
+  void renderLoop();
+
+  /**
+   * Submits the last rendered frame to the capture, if one is due (render thread only)
+   */
+  void captureTick();
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer
+ * Exactly one thread may push and exactly one (other) thread may pop.
+ * @tparam T The item type, copied in and out
+ * @tparam Capacity The number of slots, must be a power of 2
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+  SpscQueue() : head(0), tail(0) {}
+
+  /**
+   * Adds an item to the queue (producer only)
+   * @param item The item to add
+   * @return false if the queue is full
+   */
+  bool push(const T &item)
+  {
+    size_t currentTail = this->tail.load(std::memory_order_relaxed);
+    if (currentTail - this->head.load(std::memory_order_acquire) == Capacity)
+      return false;
+
+    this->items[currentTail & (Capacity - 1)] = item;
+    this->tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Takes the oldest item out of the queue (consumer only)
+   * @param item Where to write the item
+   * @return false if the queue is empty
+   */
+  bool pop(T *item)
+  {
+    size_t currentHead = this->head.load(std::memory_order_relaxed);
+    if (currentHead == this->tail.load(std::memory_order_acquire))
+      return false;
+
+    *item = this->items[currentHead & (Capacity - 1)];
+    this->head.store(currentHead + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items[Capacity];
+
+  // kept on separate cache lines so the two threads don't fight over them
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+};
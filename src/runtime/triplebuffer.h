@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cinttypes>
+
+/**
+ * Lock-free triple buffer for handing the latest value from one thread to another
+ * The writer fills writeBuffer() and publish()es it, the reader acquire()s
+ * the newest published buffer. Neither side ever waits, and stale values are
+ * simply overwritten.
+ * @tparam T The buffer type
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : middle(1), back(0), front(2) {}
+
+  /**
+   * Direct access to all three buffers, for setting them up before any thread starts
+   * @param index The buffer index (0 - 2)
+   */
+  T *buffer(int index)
+  {
+    return &this->buffers[index];
+  }
+
+  /**
+   * @return The buffer the writer should fill (writer only)
+   */
+  T *writeBuffer()
+  {
+    return &this->buffers[this->back];
+  }
+
+  /**
+   * Publishes the write buffer, and takes a fresh one to write into (writer only)
+   */
+  void publish()
+  {
+    this->back = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+  }
+
+  /**
+   * Publishes the write buffer like publish(), but lets the writer fold in
+   * the previously published value if the reader never acquired it (writer only)
+   * @param prepare Called with that value, or nullptr if the reader took it, right before publishing.
+   *                It may be called again (with nullptr) if the reader takes the value in the meantime,
+   *                so it should overwrite what it sets rather than accumulate.
+   */
+  template <typename Prepare>
+  void publish(Prepare prepare)
+  {
+    uint8_t current = this->middle.load(std::memory_order_acquire);
+    do
+    {
+      // only the writer sets FRESH, so once it is cleared the next attempt succeeds
+      prepare((current & FRESH) ? (const T *)&this->buffers[current & INDEX_MASK] : nullptr);
+    } while (!this->middle.compare_exchange_weak(current, this->back | FRESH, std::memory_order_acq_rel, std::memory_order_acquire));
+
+    this->back = current & INDEX_MASK;
+  }
+
+  /**
+   * Takes the newest published buffer, if there is one (reader only)
+   * @return true if readBuffer() changed
+   */
+  bool acquire()
+  {
+    if (!(this->middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+
+    this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  /**
+   * @return The buffer the reader currently owns (reader only)
+   */
+  T *readBuffer()
+  {
+    return &this->buffers[this->front];
+  }
+
+private:
+  static const uint8_t INDEX_MASK = 0b011;
+  static const uint8_t FRESH = 0b100;
+
+  T buffers[3];
+
+  // index of the shared buffer, plus the FRESH bit when the writer has published into it
+  std::atomic<uint8_t> middle;
+  uint8_t back;
+  uint8_t front;
+};
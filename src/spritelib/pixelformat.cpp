@@ -0,0 +1,228 @@
+#include "pixelformat.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXELFORMAT_NEON
+#endif
+
+// 4x4 Bayer threshold matrix (0 - 15)
+static const uint8_t BAYER_4X4[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5}};
+
+int bytesPerPixel(PixelFormat format)
+{
+  switch (format)
+  {
+  case PIXEL_FORMAT_RGB565:
+    return 2;
+  case PIXEL_FORMAT_BGR888:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+bool parsePixelFormat(std::string name, PixelFormat *format)
+{
+  if (name == "argb8888")
+    *format = PIXEL_FORMAT_ARGB8888;
+  else if (name == "rgb565")
+    *format = PIXEL_FORMAT_RGB565;
+  else if (name == "bgr888")
+    *format = PIXEL_FORMAT_BGR888;
+  else
+    return false;
+
+  return true;
+}
+
+static inline uint8_t saturatingAdd(uint8_t a, uint8_t b)
+{
+  int sum = a + b;
+  return sum > 255 ? 255 : sum;
+}
+
+static inline uint16_t toRGB565(uint32_t pixel)
+{
+  return ((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F);
+}
+
+/**
+ * Builds the per-pixel dither offsets for one row, packed like an ARGB8888 pixel
+ * 5-bit channels lose 3 bits (offset 0 - 7), the 6-bit channel loses 2 (offset 0 - 3)
+ */
+static void buildDitherRow(int y, uint32_t *ditherRow)
+{
+  for (int x = 0; x < 4; x++)
+  {
+    uint32_t threshold = BAYER_4X4[y % 4][x];
+    uint32_t d5 = threshold >> 1;
+    uint32_t d6 = threshold >> 2;
+    ditherRow[x] = (d5 << 16) | (d6 << 8) | d5;
+  }
+}
+
+static inline uint32_t applyDither(uint32_t pixel, uint32_t offsets)
+{
+  uint8_t r = saturatingAdd((pixel >> 16) & 0xFF, (offsets >> 16) & 0xFF);
+  uint8_t g = saturatingAdd((pixel >> 8) & 0xFF, (offsets >> 8) & 0xFF);
+  uint8_t b = saturatingAdd(pixel & 0xFF, offsets & 0xFF);
+  return (pixel & 0xFF000000) | (r << 16) | (g << 8) | b;
+}
+
+#if defined(__SSE2__)
+static inline __m128i rgb565Lanes(__m128i pixels)
+{
+  __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xF800));
+  __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x07E0));
+  __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 3), _mm_set1_epi32(0x001F));
+  __m128i packed = _mm_or_si128(_mm_or_si128(r, g), b);
+
+  // sign extend the low 16 bits so the signed saturating pack keeps them as-is
+  return _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+}
+#endif
+
+/**
+ * Converts a run of pixels to RGB565
+ * ditherRow is nullptr for no dithering. Otherwise the run must start at x = 0 of its row.
+ */
+static void convertRunRGB565(const uint32_t *src, uint16_t *dst, int count, const uint32_t *ditherRow)
+{
+  int x = 0;
+
+#if defined(__SSE2__)
+  // runs start on a multiple of 4, so each lane always gets the same dither column
+  __m128i dither = ditherRow != nullptr ? _mm_loadu_si128((const __m128i *)ditherRow) : _mm_setzero_si128();
+  for (; x + 8 <= count; x += 8)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)(src + x));
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + x + 4));
+    a = _mm_adds_epu8(a, dither);
+    b = _mm_adds_epu8(b, dither);
+    _mm_storeu_si128((__m128i *)(dst + x), _mm_packs_epi32(rgb565Lanes(a), rgb565Lanes(b)));
+  }
+#elif defined(PIXELFORMAT_NEON)
+  uint8_t d5[16];
+  uint8_t d6[16];
+  for (int i = 0; i < 16; i++)
+  {
+    uint32_t offsets = ditherRow != nullptr ? ditherRow[i % 4] : 0;
+    d5[i] = offsets & 0xFF;
+    d6[i] = (offsets >> 8) & 0xFF;
+  }
+  uint8x16_t dither5 = vld1q_u8(d5);
+  uint8x16_t dither6 = vld1q_u8(d6);
+
+  for (; x + 16 <= count; x += 16)
+  {
+    // val[0] = B, val[1] = G, val[2] = R, val[3] = A
+    uint8x16x4_t pixels = vld4q_u8((const uint8_t *)(src + x));
+    uint8x16_t b = vqaddq_u8(pixels.val[0], dither5);
+    uint8x16_t g = vqaddq_u8(pixels.val[1], dither6);
+    uint8x16_t r = vqaddq_u8(pixels.val[2], dither5);
+
+    uint16x8_t low = vshll_n_u8(vget_low_u8(r), 8);
+    low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(g), 8), 5);
+    low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(b), 8), 11);
+
+    uint16x8_t high = vshll_n_u8(vget_high_u8(r), 8);
+    high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(g), 8), 5);
+    high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(b), 8), 11);
+
+    vst1q_u16(dst + x, low);
+    vst1q_u16(dst + x + 8, high);
+  }
+#endif
+
+  for (; x < count; x++)
+  {
+    uint32_t pixel = src[x];
+    if (ditherRow != nullptr)
+      pixel = applyDither(pixel, ditherRow[x % 4]);
+    dst[x] = toRGB565(pixel);
+  }
+}
+
+static void convertRunBGR888(const uint32_t *src, uint8_t *dst, int count)
+{
+  int x = 0;
+
+#if defined(__SSSE3__)
+  // each store writes 16 bytes but only advances 12,
+  // so stop while there is still room for the 4 spare bytes
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  for (; x + 6 <= count; x += 4)
+  {
+    __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x));
+    _mm_storeu_si128((__m128i *)(dst + x * 3), _mm_shuffle_epi8(pixels, shuffle));
+  }
+#elif defined(PIXELFORMAT_NEON)
+  for (; x + 16 <= count; x += 16)
+  {
+    uint8x16x4_t pixels = vld4q_u8((const uint8_t *)(src + x));
+    uint8x16x3_t out;
+    out.val[0] = pixels.val[0];
+    out.val[1] = pixels.val[1];
+    out.val[2] = pixels.val[2];
+    vst3q_u8(dst + x * 3, out);
+  }
+#endif
+
+  for (; x < count; x++)
+  {
+    uint32_t pixel = src[x];
+    dst[x * 3] = pixel & 0xFF;
+    dst[x * 3 + 1] = (pixel >> 8) & 0xFF;
+    dst[x * 3 + 2] = (pixel >> 16) & 0xFF;
+  }
+}
+
+void convertPixels(const uint32_t *src, uint8_t *dst, uint16_t width, uint16_t height, PixelFormat format, bool dither)
+{
+  // every kernel reads a block before writing it, and writes at most as many bytes as it read,
+  // so processing front to back is safe when dst == src
+  int count = width * height;
+
+  switch (format)
+  {
+  case PIXEL_FORMAT_RGB565:
+    if (!dither)
+    {
+      convertRunRGB565(src, (uint16_t *)dst, count, nullptr);
+      break;
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+      uint32_t ditherRow[4];
+      buildDitherRow(y, ditherRow);
+      convertRunRGB565(src + y * width, (uint16_t *)dst + y * width, width, ditherRow);
+    }
+    break;
+
+  case PIXEL_FORMAT_BGR888:
+    convertRunBGR888(src, dst, count);
+    break;
+
+  default:
+    if ((const uint8_t *)src != dst)
+      std::memmove(dst, src, count * 4);
+    break;
+  }
+}
+
+void convertPixels(const uint32_t *src, uint8_t *dst, uint16_t width, uint16_t height, PixelFormat format)
+{
+  convertPixels(src, dst, width, height, format, false);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cinttypes>
+#include <string>
+
+/**
+ * Output pixel formats for display targets
+ * ARGB8888: 32 bits, what SpriteEngine renders (no conversion)
+ * RGB565: 16 bits, 0bRRRRRGGGGGGBBBBB
+ * BGR888: 24 bits, bytes in memory order B, G, R (alpha dropped)
+ */
+enum PixelFormat
+{
+  PIXEL_FORMAT_ARGB8888,
+  PIXEL_FORMAT_RGB565,
+  PIXEL_FORMAT_BGR888
+};
+
+/**
+ * @param format The pixel format
+ * @return The number of bytes a single pixel takes
+ */
+int bytesPerPixel(PixelFormat format);
+
+/**
+ * Parses a pixel format name ("argb8888", "rgb565", "bgr888")
+ * @param name The name of the format
+ * @param format Where to write the format
+ * @return false if the name is not a known format
+ */
+bool parsePixelFormat(std::string name, PixelFormat *format);
+
+/**
+ * Converts a rendered ARGB8888 frame into another pixel format
+ * Uses SSE2/SSSE3 or NEON kernels when the compiler targets them.
+ * The output is never larger than the input, so dst may be the same buffer as src
+ * to convert in place.
+ * @param src The ARGB8888 pixels
+ * @param dst The output buffer, at least width * height * bytesPerPixel(format) bytes
+ * @param width The width of the frame
+ * @param height The height of the frame
+ * @param format The format to convert to
+ * @param [dither] Apply 4x4 ordered dithering (RGB565 only)
+ */
+void convertPixels(const uint32_t *src, uint8_t *dst, uint16_t width, uint16_t height, PixelFormat format, bool dither);
+void convertPixels(const uint32_t *src, uint8_t *dst, uint16_t width, uint16_t height, PixelFormat format);
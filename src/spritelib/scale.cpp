@@ -0,0 +1,124 @@
+#include "scale.h"
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCALE_NEON
+#endif
+
+/**
+ * Widens one row, repeating every pixel scale times
+ */
+static void scaleRow(const uint32_t *src, int width, int scale, uint32_t *dst)
+{
+  int x = 0;
+
+  if (scale == 2)
+  {
+#if defined(__SSE2__)
+    for (; x + 4 <= width; x += 4)
+    {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x));
+      _mm_storeu_si128((__m128i *)(dst + x * 2), _mm_unpacklo_epi32(pixels, pixels));
+      _mm_storeu_si128((__m128i *)(dst + x * 2 + 4), _mm_unpackhi_epi32(pixels, pixels));
+    }
+#elif defined(SCALE_NEON)
+    for (; x + 4 <= width; x += 4)
+    {
+      uint32x4_t pixels = vld1q_u32(src + x);
+      uint32x4x2_t doubled = vzipq_u32(pixels, pixels);
+      vst1q_u32(dst + x * 2, doubled.val[0]);
+      vst1q_u32(dst + x * 2 + 4, doubled.val[1]);
+    }
+#endif
+  }
+  else if (scale == 4)
+  {
+#if defined(__SSE2__)
+    for (; x + 4 <= width; x += 4)
+    {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(src + x));
+      _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_shuffle_epi32(pixels, 0x00));
+      _mm_storeu_si128((__m128i *)(dst + x * 4 + 4), _mm_shuffle_epi32(pixels, 0x55));
+      _mm_storeu_si128((__m128i *)(dst + x * 4 + 8), _mm_shuffle_epi32(pixels, 0xAA));
+      _mm_storeu_si128((__m128i *)(dst + x * 4 + 12), _mm_shuffle_epi32(pixels, 0xFF));
+    }
+#elif defined(SCALE_NEON)
+    for (; x + 4 <= width; x += 4)
+    {
+      uint32x4_t pixels = vld1q_u32(src + x);
+      vst1q_u32(dst + x * 4, vdupq_n_u32(vgetq_lane_u32(pixels, 0)));
+      vst1q_u32(dst + x * 4 + 4, vdupq_n_u32(vgetq_lane_u32(pixels, 1)));
+      vst1q_u32(dst + x * 4 + 8, vdupq_n_u32(vgetq_lane_u32(pixels, 2)));
+      vst1q_u32(dst + x * 4 + 12, vdupq_n_u32(vgetq_lane_u32(pixels, 3)));
+    }
+#endif
+  }
+
+  for (; x < width; x++)
+  {
+    std::fill(dst + x * scale, dst + (x + 1) * scale, src[x]);
+  }
+}
+
+void scalePixels(const uint32_t *src, uint16_t width, uint16_t height, int scale, uint32_t *dst)
+{
+  int scaledWidth = width * scale;
+
+  for (int y = 0; y < height; y++)
+  {
+    uint32_t *row = dst + (y * scale) * scaledWidth;
+    scaleRow(src + y * width, width, scale, row);
+
+    // the other rows of this source row are plain copies
+    for (int repeat = 1; repeat < scale; repeat++)
+    {
+      std::copy(row, row + scaledWidth, row + repeat * scaledWidth);
+    }
+  }
+}
+
+void shrinkPixels(const uint32_t *src, uint16_t width, uint16_t height, int factor, uint32_t *dst, int dstStride)
+{
+  int shrunkWidth = width / factor;
+  int shrunkHeight = height / factor;
+
+  if (factor <= 1)
+  {
+    for (int y = 0; y < height; y++)
+    {
+      std::copy(src + y * width, src + (y + 1) * width, dst + y * dstStride);
+    }
+    return;
+  }
+
+  int area = factor * factor;
+  for (int y = 0; y < shrunkHeight; y++)
+  {
+    for (int x = 0; x < shrunkWidth; x++)
+    {
+      // sum each channel over the block, then round to the nearest average
+      uint32_t a = 0, r = 0, g = 0, b = 0;
+      for (int dy = 0; dy < factor; dy++)
+      {
+        const uint32_t *row = src + (y * factor + dy) * width + x * factor;
+        for (int dx = 0; dx < factor; dx++)
+        {
+          a += row[dx] >> 24;
+          r += (row[dx] >> 16) & 0xFF;
+          g += (row[dx] >> 8) & 0xFF;
+          b += row[dx] & 0xFF;
+        }
+      }
+
+      a = (a + area / 2) / area;
+      r = (r + area / 2) / area;
+      g = (g + area / 2) / area;
+      b = (b + area / 2) / area;
+      dst[y * dstStride + x] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cinttypes>
+
+/**
+ * Nearest-neighbor integer upscale of an ARGB8888 image
+ * Uses SSE2 or NEON kernels for 2x and 4x when the compiler targets them.
+ * @param src The source pixels
+ * @param width The width of the source
+ * @param height The height of the source
+ * @param scale The scale factor (1 or more)
+ * @param dst The output, (width * scale) * (height * scale) pixels, must not overlap src
+ */
+void scalePixels(const uint32_t *src, uint16_t width, uint16_t height, int scale, uint32_t *dst);
+
+/**
+ * Box-filter integer downscale of an ARGB8888 image, averaging every factor x factor block
+ * @param src The source pixels, width and height must be multiples of factor
+ * @param width The width of the source
+ * @param height The height of the source
+ * @param factor The reduction factor (1 or more)
+ * @param dst The output, (width / factor) * (height / factor) pixels, must not overlap src
+ * @param dstStride The distance between output rows in pixels, so dst can be a rectangle in a larger image
+ */
+void shrinkPixels(const uint32_t *src, uint16_t width, uint16_t height, int factor, uint32_t *dst, int dstStride);
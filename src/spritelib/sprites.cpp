@@ -1,31 +1,75 @@
 #include "sprites.h"
+#include "scale.h"
 
-Sprite loadSprite(std::string path)
+static bool isOpaque(const Sprite *sprite)
+{
+  for (int i = 0; i < sprite->width * sprite->height; i++)
+  {
+    if ((spritePixel(sprite, i) >> 24) != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+// reads a sprite file, returns false if it could not be opened
+static bool readSpriteFile(std::string path, uint16_t *width, uint16_t *height, std::vector<uint32_t> *palette, uint8_t **indices)
 {
   std::fstream file(path);
 
   if (!file.good())
   {
     std::cout << "File not found: " << path << std::endl;
-    return Sprite();
+    return false;
   }
 
   uint8_t paletteSize;
   file.read((char *)&paletteSize, 1);
+  file.read((char *)width, 2);
+  file.read((char *)height, 2);
 
-  uint16_t width;
-  file.read((char *)&width, 2);
+  palette->resize(paletteSize);
+  file.read((char *)palette->data(), paletteSize * 4);
 
-  uint16_t height;
-  file.read((char *)&height, 2);
+  *indices = new uint8_t[*width * *height];
+  file.read((char *)*indices, *width * *height);
 
-  uint32_t *palette = new uint32_t[paletteSize];
-  file.read((char *)palette, paletteSize * 4);
+  file.close();
 
-  uint8_t *pixels = new uint8_t[width * height];
-  file.read((char *)pixels, width * height);
+  // an index past the end of the palette would read out of bounds at draw time,
+  // so they are clamped here, once
+  if (palette->empty())
+    palette->push_back(0);
+  for (int i = 0; i < *width * *height; i++)
+  {
+    if ((*indices)[i] >= palette->size())
+      (*indices)[i] = palette->size() - 1;
+  }
 
-  file.close();
+  return true;
+}
+
+Sprite loadSprite(std::string path, bool indexed)
+{
+  uint16_t width;
+  uint16_t height;
+  std::vector<uint32_t> palette;
+  uint8_t *pixels;
+  if (!readSpriteFile(path, &width, &height, &palette, &pixels))
+    return Sprite();
+
+  if (indexed)
+  {
+    Palette *spritePalette = new Palette();
+    spritePalette->size = palette.size();
+    spritePalette->baseColors = new uint32_t[palette.size()];
+    spritePalette->colors = new uint32_t[palette.size()];
+    std::copy(palette.begin(), palette.end(), spritePalette->baseColors);
+    std::copy(palette.begin(), palette.end(), spritePalette->colors);
+
+    Sprite sprite = {width, height, nullptr, pixels, spritePalette, false, true};
+    sprite.opaque = isOpaque(&sprite);
+    return sprite;
+  }
 
   uint32_t *pixelColors = new uint32_t[width * height];
   for (int i = 0; i < width * height; i++)
@@ -33,12 +77,115 @@ Sprite loadSprite(std::string path)
     pixelColors[i] = palette[pixels[i]];
   }
 
-  delete[] palette;
+  delete[] pixels;
+
+  Sprite sprite = {width, height, pixelColors, nullptr, nullptr, false, false};
+  sprite.opaque = isOpaque(&sprite);
+  return sprite;
+}
+
+Sprite loadSprite(std::string path)
+{
+  return loadSprite(path, false);
+}
+
+Sprite loadSprite(std::string path, Palette *palette)
+{
+  uint16_t width;
+  uint16_t height;
+  std::vector<uint32_t> colors;
+  uint8_t *pixels;
+  if (!readSpriteFile(path, &width, &height, &colors, &pixels))
+    return Sprite();
+
+  // map every color of the file to a shared palette entry, adding the new ones
+  uint8_t remap[PALETTE_MAX_COLORS];
+  for (size_t i = 0; i < colors.size(); i++)
+  {
+    uint32_t *end = palette->baseColors + palette->size;
+    uint32_t *found = std::find(palette->baseColors, end, colors[i]);
+    if (found == end)
+    {
+      if (palette->size == PALETTE_MAX_COLORS)
+      {
+        std::cout << "Palette full, expanding " << path << std::endl;
+        delete[] pixels;
+        return loadSprite(path, false);
+      }
+
+      palette->baseColors[palette->size] = colors[i];
+      palette->colors[palette->size] = colors[i];
+      palette->size++;
+    }
+    remap[i] = found - palette->baseColors;
+  }
+
+  for (int i = 0; i < width * height; i++)
+  {
+    pixels[i] = remap[pixels[i]];
+  }
 
-  Sprite sprite = {width, height, pixelColors};
+  Sprite sprite = {width, height, nullptr, pixels, palette, false, false};
+  sprite.opaque = isOpaque(&sprite);
   return sprite;
 }
 
+Palette *createPalette()
+{
+  Palette *palette = new Palette();
+  palette->size = 0;
+  palette->baseColors = new uint32_t[PALETTE_MAX_COLORS];
+  palette->colors = new uint32_t[PALETTE_MAX_COLORS];
+  return palette;
+}
+
+void freePalette(Palette *palette)
+{
+  delete[] palette->baseColors;
+  delete[] palette->colors;
+  delete palette;
+}
+
+void freeSprite(Sprite *sprite)
+{
+  delete[] sprite->pixels;
+  delete[] sprite->indices;
+  if (sprite->palette != nullptr && sprite->ownsPalette)
+    freePalette(sprite->palette);
+
+  sprite->pixels = nullptr;
+  sprite->indices = nullptr;
+  sprite->palette = nullptr;
+  sprite->ownsPalette = false;
+}
+
+void applyPaletteFilter(Palette *palette, uint32_t (*filter)(uint32_t))
+{
+  for (int i = 0; i < palette->size; i++)
+  {
+    if (filter == nullptr)
+      palette->colors[i] = palette->baseColors[i];
+    else
+      palette->colors[i] = filter(palette->baseColors[i]);
+  }
+}
+
+uint32_t grayscaleFilter(uint32_t pixel)
+{
+  uint32_t r = (pixel >> 16) & 0xFF;
+  uint32_t g = (pixel >> 8) & 0xFF;
+  uint32_t b = pixel & 0xFF;
+
+  // integer Rec. 601 luma
+  uint32_t luma = (r * 77 + g * 150 + b * 29) >> 8;
+  return (pixel & 0xFF000000) | (luma << 16) | (luma << 8) | luma;
+}
+
+uint32_t invertFilter(uint32_t pixel)
+{
+  return pixel ^ 0x00FFFFFF;
+}
+
 ARGB parseARGB8888(uint32_t pixel)
 {
   ARGB argb;
@@ -94,10 +241,52 @@ uint32_t composePixels(uint32_t *pixels, uint8_t pixelCount)
   return constructARGB8888(working);
 }
 
+uint32_t blendPixel(uint32_t below, uint32_t above)
+{
+  // is this opaque?
+  if ((above >> 24) == 0xFF)
+    return above;
+
+  // compose with the pixel already there
+  uint32_t layers[2] = {below, above};
+  return composePixels(layers, 2);
+}
+
+void drawSprite(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *sprite, int x, int y, int scale)
+{
+  for (int targetY = std::max(y, 0); targetY < std::min(y + sprite->height * scale, (int)height); targetY++)
+  {
+    int spriteY = (targetY - y) / scale;
+    for (int targetX = std::max(x, 0); targetX < std::min(x + sprite->width * scale, (int)width); targetX++)
+    {
+      int spriteX = (targetX - x) / scale;
+      uint32_t pixel = spritePixel(sprite, spriteY * sprite->width + spriteX);
+      pixels[targetY * width + targetX] = blendPixel(pixels[targetY * width + targetX], pixel);
+    }
+  }
+}
+
+void drawSprite(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *sprite, int x, int y)
+{
+  drawSprite(pixels, width, height, sprite, x, y, 1);
+}
+
 SpriteEngine::SpriteEngine()
 {
   this->sprites = std::vector<SpriteEntry *>();
   this->next_z_index = 1;
+  this->nextOrder = 0;
+  this->queryStamp = 0;
+  this->compositeCacheBytes = 0;
+  this->compositeFrame = 0;
+
+  // room for a few hundred 16x16 composites
+  this->compositeCacheBudget = 256 * 1024;
+
+  // big enough for the VEX Brain screen, grows if a bigger target is rendered
+  this->gridColumns = 0;
+  this->gridRows = 0;
+  this->resizeGrid(512, 256);
 }
 
 SpriteEngine::~SpriteEngine()
@@ -106,35 +295,42 @@ SpriteEngine::~SpriteEngine()
   {
     delete sprite;
   }
+  this->clearCompositeCache();
+  this->clearScaledCache();
 }
 
-SpriteEntry *SpriteEngine::addSprite(Sprite *sprite, uint16_t x, uint16_t y, uint16_t z_index)
+SpriteEntry *SpriteEngine::addSprite(Sprite *sprite, int16_t x, int16_t y, uint16_t z_index)
 {
   SpriteEntry *spriteEntry = new SpriteEntry();
   spriteEntry->sprite = sprite;
   spriteEntry->x = x;
   spriteEntry->y = y;
   spriteEntry->z_index = z_index;
+  spriteEntry->order = this->nextOrder++;
+  spriteEntry->queryStamp = 0;
   this->sprites.push_back(spriteEntry);
+  this->insertIntoGrid(spriteEntry);
   return spriteEntry;
 }
 
-SpriteEntry *SpriteEngine::addSprite(Sprite *sprite, uint16_t x, uint16_t y)
+SpriteEntry *SpriteEngine::addSprite(Sprite *sprite, int16_t x, int16_t y)
 {
   return this->addSprite(sprite, x, y, this->next_z_index++);
 }
 
-void SpriteEngine::moveSprite(SpriteEntry *sprite, uint16_t x, uint16_t y, uint16_t z_index)
+void SpriteEngine::moveSprite(SpriteEntry *sprite, int16_t x, int16_t y, uint16_t z_index)
 {
   // TODO: it may be nice to verify if the entry is in the list
   // It will be slow, but it will be nice to have
 
+  this->removeFromGrid(sprite);
   sprite->x = x;
   sprite->y = y;
   sprite->z_index = z_index;
+  this->insertIntoGrid(sprite);
 }
 
-void SpriteEngine::moveSprite(SpriteEntry *sprite, uint16_t x, uint16_t y)
+void SpriteEngine::moveSprite(SpriteEntry *sprite, int16_t x, int16_t y)
 {
   this->moveSprite(sprite, x, y, sprite->z_index);
 }
@@ -145,6 +341,7 @@ void SpriteEngine::removeSprite(SpriteEntry *sprite)
   if (itr != this->sprites.end())
   {
     this->sprites.erase(itr);
+    this->removeFromGrid(sprite);
   }
 
   delete sprite;
@@ -157,48 +354,413 @@ void SpriteEngine::clearSprites()
     delete sprite;
   }
   this->sprites.clear();
+
+  for (std::vector<SpriteEntry *> &cell : this->cells)
+  {
+    cell.clear();
+  }
+  this->nextOrder = 0;
+
+  // nothing points at the composites anymore, so the last frame's can go now
+  this->compositeFrame++;
+  this->evictComposites();
 }
 
-void SpriteEngine::renderSprites(uint32_t *pixels, uint16_t width, uint16_t height)
+void SpriteEngine::renderSprites(uint32_t *pixels, uint16_t width, uint16_t height, SpriteRect clip)
 {
-  this->reshuffleSprites();
+  // clip to the target
+  int clipX0 = std::max(clip.x, 0);
+  int clipY0 = std::max(clip.y, 0);
+  int clipX1 = std::min(clip.x + clip.width, (int)width);
+  int clipY1 = std::min(clip.y + clip.height, (int)height);
+  if (clipX0 >= clipX1 || clipY0 >= clipY1)
+    return;
+
+  if (width > this->gridColumns * CELL_SIZE || height > this->gridRows * CELL_SIZE)
+    this->resizeGrid(width, height);
 
   // set all pixels to white
-  std::fill(pixels, pixels + width * height, 0xFFFFFFFF);
+  for (int y = clipY0; y < clipY1; y++)
+  {
+    std::fill(pixels + y * width + clipX0, pixels + y * width + clipX1, 0xFFFFFFFF);
+  }
+
+  // only visit sprites that can be seen, bottom to top
+  this->querySprites({clipX0, clipY0, clipX1 - clipX0, clipY1 - clipY0}, &this->visibleSprites);
+  std::sort(this->visibleSprites.begin(), this->visibleSprites.end(), [](SpriteEntry *a, SpriteEntry *b)
+            { return a->z_index != b->z_index ? a->z_index < b->z_index : a->order < b->order; });
 
-  uint32_t *pixelLayerBuffer = new uint32_t[2];
+  for (SpriteEntry *sprite : this->visibleSprites)
+  {
+    if (sprite->z_index == 0)
+      continue;
+
+    Sprite *source = sprite->sprite;
+
+    // the part of the sprite inside the clip rect
+    int x0 = std::max((int)sprite->x, clipX0);
+    int y0 = std::max((int)sprite->y, clipY0);
+    int x1 = std::min(sprite->x + source->width, clipX1);
+    int y1 = std::min(sprite->y + source->height, clipY1);
+
+    for (int y = y0; y < y1; y++)
+    {
+      uint32_t *row = pixels + y * width;
+      int sourceRow = (y - sprite->y) * source->width - sprite->x;
+
+      // opaque sprites can skip blending
+      if (source->opaque && source->pixels != nullptr)
+      {
+        std::copy(source->pixels + sourceRow + x0, source->pixels + sourceRow + x1, row + x0);
+      }
+      else if (source->opaque)
+      {
+        for (int x = x0; x < x1; x++)
+        {
+          row[x] = spritePixel(source, sourceRow + x);
+        }
+      }
+      else
+      {
+        for (int x = x0; x < x1; x++)
+        {
+          row[x] = blendPixel(row[x], spritePixel(source, sourceRow + x));
+        }
+      }
+    }
+  }
+}
+
+void SpriteEngine::renderSprites(uint32_t *pixels, uint16_t width, uint16_t height)
+{
+  this->renderSprites(pixels, width, height, {0, 0, width, height});
+}
+
+void SpriteEngine::querySprites(SpriteRect rect, std::vector<SpriteEntry *> *result)
+{
+  result->clear();
+  if (rect.width <= 0 || rect.height <= 0)
+    return;
+
+  int cellX0 = std::clamp(rect.x >> CELL_SHIFT, 0, this->gridColumns - 1);
+  int cellY0 = std::clamp(rect.y >> CELL_SHIFT, 0, this->gridRows - 1);
+  int cellX1 = std::clamp((rect.x + rect.width - 1) >> CELL_SHIFT, 0, this->gridColumns - 1);
+  int cellY1 = std::clamp((rect.y + rect.height - 1) >> CELL_SHIFT, 0, this->gridRows - 1);
+
+  // sprites covering several cells are only reported once
+  this->queryStamp++;
+
+  for (int cellY = cellY0; cellY <= cellY1; cellY++)
+  {
+    for (int cellX = cellX0; cellX <= cellX1; cellX++)
+    {
+      for (SpriteEntry *sprite : this->cells[cellX + cellY * this->gridColumns])
+      {
+        if (sprite->queryStamp == this->queryStamp)
+          continue;
+        sprite->queryStamp = this->queryStamp;
+
+        // the edge cells also hold sprites outside the grid, so check the real bounds
+        if (sprite->x >= rect.x + rect.width || sprite->x + sprite->sprite->width <= rect.x ||
+            sprite->y >= rect.y + rect.height || sprite->y + sprite->sprite->height <= rect.y)
+          continue;
+
+        result->push_back(sprite);
+      }
+    }
+  }
+}
+
+void SpriteEngine::spritesAt(int x, int y, std::vector<SpriteEntry *> *result)
+{
+  this->querySprites({x, y, 1, 1}, result);
+  std::sort(result->begin(), result->end(), [](SpriteEntry *a, SpriteEntry *b)
+            { return a->z_index != b->z_index ? a->z_index > b->z_index : a->order > b->order; });
+}
+
+void SpriteEngine::insertIntoGrid(SpriteEntry *sprite)
+{
+  // empty sprites cover nothing
+  if (sprite->sprite->width == 0 || sprite->sprite->height == 0)
+  {
+    sprite->cellX0 = 0;
+    sprite->cellX1 = -1;
+    sprite->cellY0 = 0;
+    sprite->cellY1 = -1;
+    return;
+  }
+
+  sprite->cellX0 = std::clamp(sprite->x >> CELL_SHIFT, 0, this->gridColumns - 1);
+  sprite->cellY0 = std::clamp(sprite->y >> CELL_SHIFT, 0, this->gridRows - 1);
+  sprite->cellX1 = std::clamp((sprite->x + sprite->sprite->width - 1) >> CELL_SHIFT, 0, this->gridColumns - 1);
+  sprite->cellY1 = std::clamp((sprite->y + sprite->sprite->height - 1) >> CELL_SHIFT, 0, this->gridRows - 1);
+
+  for (int cellY = sprite->cellY0; cellY <= sprite->cellY1; cellY++)
+  {
+    for (int cellX = sprite->cellX0; cellX <= sprite->cellX1; cellX++)
+    {
+      this->cells[cellX + cellY * this->gridColumns].push_back(sprite);
+    }
+  }
+}
+
+void SpriteEngine::removeFromGrid(SpriteEntry *sprite)
+{
+  for (int cellY = sprite->cellY0; cellY <= sprite->cellY1; cellY++)
+  {
+    for (int cellX = sprite->cellX0; cellX <= sprite->cellX1; cellX++)
+    {
+      std::vector<SpriteEntry *> &cell = this->cells[cellX + cellY * this->gridColumns];
+      auto itr = std::find(cell.begin(), cell.end(), sprite);
+      if (itr != cell.end())
+      {
+        // order within a cell doesn't matter
+        *itr = cell.back();
+        cell.pop_back();
+      }
+    }
+  }
+}
+
+void SpriteEngine::resizeGrid(int width, int height)
+{
+  this->gridColumns = std::max((width + CELL_SIZE - 1) >> CELL_SHIFT, 1);
+  this->gridRows = std::max((height + CELL_SIZE - 1) >> CELL_SHIFT, 1);
+  this->cells.assign(this->gridColumns * this->gridRows, std::vector<SpriteEntry *>());
 
   for (SpriteEntry *sprite : this->sprites)
   {
-    for (int x = sprite->x; x < sprite->x + sprite->sprite->width; x++)
+    this->insertIntoGrid(sprite);
+  }
+}
+
+Sprite *SpriteEngine::getComposite(const SpriteLayer *layers, int layerCount)
+{
+  // built field by field, the struct padding would make the key unreliable
+  std::string key;
+  for (int l = 0; l < layerCount; l++)
+  {
+    key.append((const char *)&layers[l].sprite, sizeof(Sprite *));
+    key.append((const char *)&layers[l].dx, sizeof(int16_t));
+    key.append((const char *)&layers[l].dy, sizeof(int16_t));
+  }
+
+  auto found = this->compositeIndex.find(key);
+  if (found != this->compositeIndex.end())
+  {
+    // mark as most recently used
+    this->compositeCache.splice(this->compositeCache.begin(), this->compositeCache, found->second);
+    found->second->frame = this->compositeFrame;
+    return &found->second->sprite;
+  }
+
+  Sprite *base = layers[0].sprite;
+  int width = base->width;
+  int height = base->height;
+
+  uint32_t *pixels = new uint32_t[width * height];
+  for (int i = 0; i < width * height; i++)
+  {
+    pixels[i] = spritePixel(base, i);
+  }
+
+  for (int l = 1; l < layerCount; l++)
+  {
+    const SpriteLayer &layer = layers[l];
+    for (int y = 0; y < layer.sprite->height; y++)
     {
-      for (int y = sprite->y; y < sprite->y + sprite->sprite->height; y++)
+      for (int x = 0; x < layer.sprite->width; x++)
       {
-        if (x < 0 || x >= width || y < 0 || y >= height)
+        int targetX = x + layer.dx;
+        int targetY = y + layer.dy;
+        if (targetX < 0 || targetX >= width || targetY < 0 || targetY >= height)
           continue;
 
-        uint32_t pixel = sprite->sprite->pixels[(y - sprite->y) * sprite->sprite->width + (x - sprite->x)];
-        // is this opaque?
-        if ((pixel >> 24) == 0xFF)
-        {
-          pixels[y * width + x] = pixel;
-        }
-        else
+        uint32_t pixel = spritePixel(layer.sprite, y * layer.sprite->width + x);
+        pixels[targetY * width + targetX] = blendPixel(pixels[targetY * width + targetX], pixel);
+      }
+    }
+  }
+
+  CompositeEntry entry;
+  entry.key = key;
+  entry.sprite = {(uint16_t)width, (uint16_t)height, pixels, nullptr, nullptr, false, false};
+  entry.sprite.opaque = isOpaque(&entry.sprite);
+  entry.frame = this->compositeFrame;
+
+  this->compositeCache.push_front(entry);
+  this->compositeIndex[key] = this->compositeCache.begin();
+  this->compositeSprites.insert(&this->compositeCache.front().sprite);
+  this->compositeCacheBytes += width * height * sizeof(uint32_t);
+  this->evictComposites();
+
+  return &this->compositeCache.front().sprite;
+}
+
+void SpriteEngine::setCompositeCacheBudget(size_t bytes)
+{
+  this->compositeCacheBudget = bytes;
+  this->evictComposites();
+}
+
+void SpriteEngine::clearCompositeCache()
+{
+  for (CompositeEntry &entry : this->compositeCache)
+  {
+    this->releaseScaled(&entry.sprite);
+    freeSprite(&entry.sprite);
+  }
+  this->compositeCache.clear();
+  this->compositeIndex.clear();
+  this->compositeSprites.clear();
+  this->compositeCacheBytes = 0;
+}
+
+void SpriteEngine::evictComposites()
+{
+  // used composites move to the front, so once the oldest one is from this frame all of them are.
+  // sprites added this frame may still point at them
+  while (this->compositeCacheBytes > this->compositeCacheBudget && !this->compositeCache.empty())
+  {
+    CompositeEntry &oldest = this->compositeCache.back();
+    if (oldest.frame == this->compositeFrame)
+      break;
+
+    this->compositeCacheBytes -= oldest.sprite.width * oldest.sprite.height * sizeof(uint32_t);
+    this->compositeCacheBytes -= this->releaseScaled(&oldest.sprite);
+    this->compositeIndex.erase(oldest.key);
+    this->compositeSprites.erase(&oldest.sprite);
+    freeSprite(&oldest.sprite);
+    this->compositeCache.pop_back();
+  }
+}
+
+Sprite *SpriteEngine::getScaled(Sprite *sprite, int scale)
+{
+  if (scale <= 1)
+    return sprite;
+
+  auto found = this->scaledCache.find({sprite, scale});
+  if (found != this->scaledCache.end())
+    return &found->second;
+
+  Sprite scaled = {(uint16_t)(sprite->width * scale), (uint16_t)(sprite->height * scale), nullptr, nullptr, nullptr, sprite->opaque, false};
+
+  if (sprite->indices != nullptr)
+  {
+    // replicate the indices, the palette is shared with the source
+    scaled.indices = new uint8_t[scaled.width * scaled.height];
+    scaled.palette = sprite->palette;
+    for (int y = 0; y < scaled.height; y++)
+    {
+      for (int x = 0; x < scaled.width; x++)
+      {
+        scaled.indices[y * scaled.width + x] = sprite->indices[(y / scale) * sprite->width + x / scale];
+      }
+    }
+  }
+  else
+  {
+    scaled.pixels = new uint32_t[scaled.width * scaled.height];
+    scalePixels(sprite->pixels, sprite->width, sprite->height, scale, scaled.pixels);
+  }
+
+  return this->storeScaled(sprite, scale, scaled);
+}
+
+Sprite *SpriteEngine::getShrunk(Sprite *sprite, int factor)
+{
+  if (factor <= 1)
+    return sprite;
+
+  auto found = this->scaledCache.find({sprite, -factor});
+  if (found != this->scaledCache.end())
+    return &found->second;
+
+  Sprite shrunk = {(uint16_t)(sprite->width / factor), (uint16_t)(sprite->height / factor), nullptr, nullptr, nullptr, false, false};
+  shrunk.pixels = new uint32_t[shrunk.width * shrunk.height];
+
+  std::vector<uint32_t> source(sprite->width * sprite->height);
+  for (int i = 0; i < sprite->width * sprite->height; i++)
+  {
+    source[i] = spritePixel(sprite, i);
+  }
+
+  if (sprite->opaque)
+  {
+    shrinkPixels(source.data(), sprite->width, sprite->height, factor, shrunk.pixels, shrunk.width);
+  }
+  else
+  {
+    // weigh the colors by alpha, so (invisible) colors of transparent pixels don't bleed in
+    for (int y = 0; y < shrunk.height; y++)
+    {
+      for (int x = 0; x < shrunk.width; x++)
+      {
+        uint32_t a = 0, r = 0, g = 0, b = 0;
+        for (int dy = 0; dy < factor; dy++)
         {
-          // compose with the pixel already there
-          pixelLayerBuffer[0] = pixels[y * width + x];
-          pixelLayerBuffer[1] = pixel;
-          pixels[y * width + x] = composePixels(pixelLayerBuffer, 2);
+          for (int dx = 0; dx < factor; dx++)
+          {
+            uint32_t pixel = source[(y * factor + dy) * sprite->width + x * factor + dx];
+            uint32_t alpha = pixel >> 24;
+            a += alpha;
+            r += ((pixel >> 16) & 0xFF) * alpha;
+            g += ((pixel >> 8) & 0xFF) * alpha;
+            b += (pixel & 0xFF) * alpha;
+          }
         }
+
+        uint32_t pixel = (a / (factor * factor)) << 24;
+        if (a != 0)
+          pixel |= (r / a) << 16 | (g / a) << 8 | b / a;
+        shrunk.pixels[y * shrunk.width + x] = pixel;
       }
     }
   }
 
-  delete[] pixelLayerBuffer;
+  shrunk.opaque = isOpaque(&shrunk);
+  return this->storeScaled(sprite, -factor, shrunk);
 }
 
-void SpriteEngine::reshuffleSprites()
+Sprite *SpriteEngine::storeScaled(Sprite *sprite, int key, Sprite scaled)
 {
-  std::sort(this->sprites.begin(), this->sprites.end(), [](SpriteEntry *a, SpriteEntry *b)
-            { return a->z_index < b->z_index; });
+  Sprite *result = &(this->scaledCache[{sprite, key}] = scaled);
+
+  // a scaled composite lives as long as the composite, so it counts against the same budget
+  if (this->compositeSprites.count(sprite) != 0)
+  {
+    this->compositeCacheBytes += scaled.width * scaled.height * sizeof(uint32_t);
+    this->evictComposites();
+  }
+
+  return result;
+}
+
+void SpriteEngine::clearScaledCache()
+{
+  for (auto &entry : this->scaledCache)
+  {
+    if (this->compositeSprites.count(entry.first.first) != 0)
+      this->compositeCacheBytes -= entry.second.width * entry.second.height * sizeof(uint32_t);
+
+    // the palette belongs to the source sprite
+    delete[] entry.second.pixels;
+    delete[] entry.second.indices;
+  }
+  this->scaledCache.clear();
+}
+
+size_t SpriteEngine::releaseScaled(Sprite *sprite)
+{
+  size_t bytes = 0;
+  auto itr = this->scaledCache.lower_bound({sprite, INT_MIN});
+  while (itr != this->scaledCache.end() && itr->first.first == sprite)
+  {
+    bytes += itr->second.width * itr->second.height * (itr->second.pixels != nullptr ? sizeof(uint32_t) : 1);
+    delete[] itr->second.pixels;
+    delete[] itr->second.indices;
+    itr = this->scaledCache.erase(itr);
+  }
+  return bytes;
 }
\ No newline at end of file
@@ -2,25 +2,79 @@
 #include <iostream>
 #include <fstream>
 #include <cinttypes>
+#include <climits>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+// the most colors a palette can hold, indices are 8 bit
+const int PALETTE_MAX_COLORS = 256;
+
+struct Palette
+{
+  // number of colors in use, the arrays hold this many (PALETTE_MAX_COLORS for createPalette)
+  uint16_t size;
+  // colors as stored in the sprite file
+  uint32_t *baseColors;
+  // colors used when drawing, may be filtered (see applyPaletteFilter)
+  uint32_t *colors;
+};
 
 struct Sprite
 {
   uint16_t width;
   uint16_t height;
+  // expanded ARGB8888 pixels, nullptr for indexed sprites
   uint32_t *pixels;
+  // palette indices, nullptr for expanded sprites
+  uint8_t *indices;
+  Palette *palette;
+  // every pixel is fully opaque, so it can be drawn without blending
+  bool opaque;
+  // freeSprite frees the palette too, false when it is shared (see createPalette)
+  bool ownsPalette;
+};
+
+/**
+ * One layer of a composite sprite (see SpriteEngine::getComposite)
+ */
+struct SpriteLayer
+{
+  Sprite *sprite;
+  // offset from the first layer
+  int16_t dx;
+  int16_t dy;
 };
 
 struct SpriteEntry
 {
   Sprite *sprite;
-  uint16_t x;
-  uint16_t y;
+  // may be negative, or past the edge of the target, the sprite is clipped
+  int16_t x;
+  int16_t y;
   // Higher z index means the sprite is rendered on top of other sprites
   // 0 is do not render
   uint16_t z_index;
+
+  // spatial index bookkeeping, managed by SpriteEngine
+  uint32_t order;
+  uint32_t queryStamp;
+  int16_t cellX0;
+  int16_t cellY0;
+  int16_t cellX1;
+  int16_t cellY1;
+};
+
+struct SpriteRect
+{
+  int x;
+  int y;
+  int width;
+  int height;
 };
 
 struct ARGB
@@ -34,10 +88,68 @@ struct ARGB
 /**
  * Loads a sprite from a file
  * @param path The path to the sprite file
+ * @param [indexed] Keep the 8-bit palette indices instead of expanding to ARGB8888,
+ *                  with a palette of its own sized to the file's colors.
+ *                  The colors can be changed later through the palette.
  * @return The sprite
  */
+Sprite loadSprite(std::string path, bool indexed);
 Sprite loadSprite(std::string path);
 
+/**
+ * Loads an indexed sprite whose colors are merged into a shared palette,
+ * so a whole sprite set costs one palette, and recoloring it is one applyPaletteFilter call.
+ * Falls back to an expanded sprite if the palette has no room for its colors.
+ * Loading only appends entries, so other threads may keep drawing sprites that use the existing ones
+ * (drawing reads colors[index], never size). Loads must not overlap each other or applyPaletteFilter.
+ * @param path The path to the sprite file
+ * @param palette The shared palette (see createPalette), it must outlive the sprite
+ * @return The sprite
+ */
+Sprite loadSprite(std::string path, Palette *palette);
+
+/**
+ * Creates an empty palette with room for PALETTE_MAX_COLORS colors, for sharing between sprites
+ * @return The palette, free it with freePalette
+ */
+Palette *createPalette();
+
+void freePalette(Palette *palette);
+
+/**
+ * Frees the pixel data (and palette, unless it is shared) owned by a sprite
+ * @param sprite The sprite to free
+ */
+void freeSprite(Sprite *sprite);
+
+/**
+ * Gets the ARGB8888 color of a pixel, resolving the palette for indexed sprites
+ * @param sprite The sprite
+ * @param index The pixel index (y * width + x)
+ * @return The pixel
+ */
+inline uint32_t spritePixel(const Sprite *sprite, int index)
+{
+  if (sprite->indices != nullptr)
+    return sprite->palette->colors[sprite->indices[index]];
+
+  return sprite->pixels[index];
+}
+
+/**
+ * Recolors a palette by running every base color through a filter.
+ * Every indexed sprite using the palette changes on the next render.
+ * @param palette The palette to recolor
+ * @param filter The color filter, nullptr restores the original colors
+ */
+void applyPaletteFilter(Palette *palette, uint32_t (*filter)(uint32_t));
+
+/**
+ * Color filters for applyPaletteFilter. These keep the alpha channel.
+ */
+uint32_t grayscaleFilter(uint32_t pixel);
+uint32_t invertFilter(uint32_t pixel);
+
 /**
  * Deconstructs a uint32_t into an ARGB struct
  * @param pixel The pixel to deconstruct
@@ -63,6 +175,28 @@ ARGB composePair(ARGB a, ARGB b);
 // composes pixels, respecting alpha
 uint32_t composePixels(uint32_t *pixels, uint8_t pixelCount);
 
+/**
+ * Draws one pixel on top of another, the same way renderSprites does
+ * @param below The pixel already there
+ * @param above The pixel being drawn
+ * @return The resulting pixel
+ */
+uint32_t blendPixel(uint32_t below, uint32_t above);
+
+/**
+ * Draws a single sprite straight into a pixel array, blending like renderSprites does
+ * Useful for overlays drawn on top of an already rendered frame.
+ * @param pixels The pixel array to draw to
+ * @param width The width of the pixel array
+ * @param height The height of the pixel array
+ * @param sprite The sprite to draw
+ * @param x The x position of the sprite
+ * @param y The y position of the sprite
+ * @param [scale] The integer scale factor, every sprite pixel becomes a scale x scale block
+ */
+void drawSprite(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *sprite, int x, int y, int scale);
+void drawSprite(uint32_t *pixels, uint16_t width, uint16_t height, Sprite *sprite, int x, int y);
+
 class SpriteEngine
 {
 public:
@@ -78,8 +212,8 @@ public:
    * @param y The y position of the sprite
    * @param [z_index] The z index of the sprite
    */
-  SpriteEntry *addSprite(Sprite *sprite, uint16_t x, uint16_t y, uint16_t z_index);
-  SpriteEntry *addSprite(Sprite *sprite, uint16_t x, uint16_t y);
+  SpriteEntry *addSprite(Sprite *sprite, int16_t x, int16_t y, uint16_t z_index);
+  SpriteEntry *addSprite(Sprite *sprite, int16_t x, int16_t y);
 
   /**
    * Moves a sprite to a new position
@@ -88,8 +222,8 @@ public:
    * @param y The new y position of the sprite
    * @param [z_index] The new z index of the sprite
    */
-  void moveSprite(SpriteEntry *sprite, uint16_t x, uint16_t y, uint16_t z_index);
-  void moveSprite(SpriteEntry *sprite, uint16_t x, uint16_t y);
+  void moveSprite(SpriteEntry *sprite, int16_t x, int16_t y, uint16_t z_index);
+  void moveSprite(SpriteEntry *sprite, int16_t x, int16_t y);
 
   /**
    * Removes a sprite from the sprite engine. This is O(n) so it's not recommended to call this every frame.
@@ -106,18 +240,135 @@ public:
 
   /**
    * Renders all sprites to a pixel array
+   * Only sprites that overlap the target are visited.
    * @param pixels The pixel array to render to
    * @param width The width of the pixel array
    * @param height The height of the pixel array
+   * @param [clip] Only redraw this part of the pixel array, the rest is left as-is
    */
+  void renderSprites(uint32_t *pixels, uint16_t width, uint16_t height, SpriteRect clip);
   void renderSprites(uint32_t *pixels, uint16_t width, uint16_t height);
 
+  /**
+   * Finds every sprite overlapping a rectangle
+   * @param rect The rectangle
+   * @param result Where to put the sprites (cleared first), in no particular order
+   */
+  void querySprites(SpriteRect rect, std::vector<SpriteEntry *> *result);
+
+  /**
+   * Finds every sprite covering a point, e.g. for mouse picking
+   * @param x The x position
+   * @param y The y position
+   * @param result Where to put the sprites (cleared first), topmost first
+   */
+  void spritesAt(int x, int y, std::vector<SpriteEntry *> *result);
+
+  /**
+   * Gets a sprite with a stack of layers pre-blended into it, building it on first use.
+   * The composite has the size of the first layer, later layers are clipped to it.
+   * Drawing it is the same as drawing every layer in order, as long as the first layer is opaque.
+   * The composite is owned by the cache, and stays valid until it is evicted or the cache is cleared.
+   * Composites used since the last clearSprites() are never evicted, so sprites added with them stay drawable.
+   * @param layers The layers, bottom to top
+   * @param layerCount The number of layers
+   * @return The composite sprite
+   */
+  Sprite *getComposite(const SpriteLayer *layers, int layerCount);
+
+  /**
+   * Sets how much pixel memory the composite cache may hold, scaled copies of composites included.
+   * The least recently used composites are evicted past this, except the ones
+   * used since the last clearSprites(), so a single frame may go over it.
+   * @param bytes The budget in bytes
+   */
+  void setCompositeCacheBudget(size_t bytes);
+
+  /**
+   * Gets an integer-scaled copy of a sprite, building it on first use.
+   * Scaled copies of indexed sprites keep using the original palette, so palette filters still apply.
+   * The copy is owned by the engine and stays valid as long as the source sprite does
+   * (for composites: until it is evicted or the cache is cleared).
+   * @param sprite The sprite to scale
+   * @param scale The integer scale factor, 1 returns the sprite itself
+   * @return The scaled sprite
+   */
+  Sprite *getScaled(Sprite *sprite, int scale);
+
+  /**
+   * Gets a box-filtered, integer-downscaled copy of a sprite, building it on first use.
+   * The downscale counterpart of getScaled, for drawing small previews without shrinking whole frames.
+   * The copy is always ARGB8888, so palette filters only show on it after clearScaledCache().
+   * It is owned by the engine and stays valid like a getScaled copy.
+   * @param sprite The sprite to shrink
+   * @param factor The reduction factor, must divide the width and height, 1 returns the sprite itself
+   * @return The shrunk sprite
+   */
+  Sprite *getShrunk(Sprite *sprite, int factor);
+
+  /**
+   * Frees every scaled (and shrunk) copy. Call this if a source sprite is freed or its pixels change.
+   */
+  void clearScaledCache();
+
+  /**
+   * Frees every composite. Call this when the pixels of a cached layer change
+   * (e.g. after a palette filter), and before drawing sprites from the old composites again.
+   */
+  void clearCompositeCache();
+
 private:
   uint16_t next_z_index;
+  uint32_t nextOrder;
+
+  // uniform grid of CELL_SIZE cells over the render target
+  // sprites outside of it are kept in the edge cells
+  static const int CELL_SHIFT = 5;
+  static const int CELL_SIZE = 1 << CELL_SHIFT;
+  int gridColumns;
+  int gridRows;
+  std::vector<std::vector<SpriteEntry *>> cells;
+  uint32_t queryStamp;
+
+  // scratch list for renderSprites
+  std::vector<SpriteEntry *> visibleSprites;
+
+  void insertIntoGrid(SpriteEntry *sprite);
+  void removeFromGrid(SpriteEntry *sprite);
+  void resizeGrid(int width, int height);
+
+  struct CompositeEntry
+  {
+    std::string key;
+    Sprite sprite;
+    // compositeFrame when it was last used
+    uint32_t frame;
+  };
+
+  // most recently used at the front
+  std::list<CompositeEntry> compositeCache;
+  std::unordered_map<std::string, std::list<CompositeEntry>::iterator> compositeIndex;
+  size_t compositeCacheBytes;
+  size_t compositeCacheBudget;
+  // bumped by clearSprites(), composites used in the current frame are pinned
+  uint32_t compositeFrame;
+
+  void evictComposites();
+
+  // the sprites in compositeCache, their scaled copies count against the budget
+  std::unordered_set<const Sprite *> compositeSprites;
+
+  // keyed by the scale factor, shrunk copies by the negated reduction factor
+  std::map<std::pair<Sprite *, int>, Sprite> scaledCache;
+
+  /**
+   * Keeps a new scaled or shrunk copy, counting it against the composite budget if its source is a composite
+   */
+  Sprite *storeScaled(Sprite *sprite, int key, Sprite scaled);
 
   /**
-   * Reshuffles the sprites vector so that the sprites
-   * are sorted by z index high-to-low
+   * Frees the scaled copies of one sprite
+   * @return The bytes freed
    */
-  void reshuffleSprites();
+  size_t releaseScaled(Sprite *sprite);
 };
\ No newline at end of file
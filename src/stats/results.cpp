@@ -0,0 +1,217 @@
+#include "results.h"
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char RESULT_MAGIC[8] = {'M', 'S', 'R', 'E', 'S', 'U', 'L', 'T'};
+static const uint32_t RESULT_VERSION = 1;
+
+struct ResultFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t blockRecords;
+  uint64_t count;
+  uint8_t reserved[40];
+};
+
+// column offsets inside a block, widest first so every column stays aligned
+static const size_t POOL_INDEX_OFFSET = 0;
+static const size_t DURATION_OFFSET = POOL_INDEX_OFFSET + RESULT_BLOCK_RECORDS * 4;
+static const size_t FIRST_CLICK_OFFSET = DURATION_OFFSET + RESULT_BLOCK_RECORDS * 4;
+static const size_t REVEALS_OFFSET = FIRST_CLICK_OFFSET + RESULT_BLOCK_RECORDS * 2;
+static const size_t FLAGS_OFFSET = REVEALS_OFFSET + RESULT_BLOCK_RECORDS * 2;
+static const size_t BBBV_OFFSET = FLAGS_OFFSET + RESULT_BLOCK_RECORDS * 2;
+static const size_t TRANSFORM_OFFSET = BBBV_OFFSET + RESULT_BLOCK_RECORDS * 2;
+static const size_t RESULT_OFFSET = TRANSFORM_OFFSET + RESULT_BLOCK_RECORDS;
+static const size_t BLOCK_SIZE = RESULT_OFFSET + RESULT_BLOCK_RECORDS;
+
+ResultStore::ResultStore()
+{
+  this->fd = -1;
+  this->writable = false;
+  this->mapping = nullptr;
+  this->mappingSize = 0;
+}
+
+ResultStore::~ResultStore()
+{
+  this->close();
+}
+
+bool ResultStore::open(std::string path, bool writable)
+{
+  this->close();
+
+  this->fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (this->fd < 0)
+  {
+    std::cout << "Could not open results file: " << path << std::endl;
+    return false;
+  }
+  this->writable = writable;
+
+  // a second writer would corrupt the count and the block growth, readers are fine.
+  // the lock goes away with the descriptor
+  if (writable && flock(this->fd, LOCK_EX | LOCK_NB) != 0)
+  {
+    std::cout << "Results file is already open for writing elsewhere: " << path << std::endl;
+    this->close();
+    return false;
+  }
+
+  struct stat info;
+  fstat(this->fd, &info);
+
+  // new file, write the header
+  if (info.st_size == 0 && writable)
+  {
+    ResultFileHeader header = ResultFileHeader();
+    memcpy(header.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC));
+    header.version = RESULT_VERSION;
+    header.blockRecords = RESULT_BLOCK_RECORDS;
+    header.count = 0;
+
+    if (write(this->fd, &header, sizeof(header)) != sizeof(header))
+    {
+      std::cout << "Could not write results file: " << path << std::endl;
+      this->close();
+      return false;
+    }
+  }
+
+  if (!this->map())
+  {
+    std::cout << "Could not map results file: " << path << std::endl;
+    this->close();
+    return false;
+  }
+
+  ResultFileHeader *header = (ResultFileHeader *)this->mapping;
+  if (memcmp(header->magic, RESULT_MAGIC, sizeof(RESULT_MAGIC)) != 0 || header->version != RESULT_VERSION || header->blockRecords != RESULT_BLOCK_RECORDS)
+  {
+    std::cout << "Not a results file: " << path << std::endl;
+    this->close();
+    return false;
+  }
+
+  return true;
+}
+
+void ResultStore::close()
+{
+  this->unmap();
+  if (this->fd >= 0)
+  {
+    ::close(this->fd);
+    this->fd = -1;
+  }
+}
+
+bool ResultStore::isOpen()
+{
+  return this->mapping != nullptr;
+}
+
+bool ResultStore::append(const GameResult &result)
+{
+  if (!this->writable || this->mapping == nullptr)
+    return false;
+
+  uint64_t count = ((ResultFileHeader *)this->mapping)->count;
+  uint64_t blockIndex = count / RESULT_BLOCK_RECORDS;
+  uint32_t slot = count % RESULT_BLOCK_RECORDS;
+
+  // the last block is full, add another
+  size_t needed = sizeof(ResultFileHeader) + (blockIndex + 1) * BLOCK_SIZE;
+  if (this->mappingSize < needed)
+  {
+    this->unmap();
+    if (ftruncate(this->fd, needed) != 0 || !this->map())
+    {
+      std::cout << "Could not grow results file" << std::endl;
+      return false;
+    }
+  }
+
+  uint8_t *block = this->mapping + sizeof(ResultFileHeader) + blockIndex * BLOCK_SIZE;
+  ((uint32_t *)(block + POOL_INDEX_OFFSET))[slot] = result.poolIndex;
+  ((uint32_t *)(block + DURATION_OFFSET))[slot] = result.duration;
+  ((uint16_t *)(block + FIRST_CLICK_OFFSET))[slot] = result.firstClick;
+  ((uint16_t *)(block + REVEALS_OFFSET))[slot] = result.reveals;
+  ((uint16_t *)(block + FLAGS_OFFSET))[slot] = result.flags;
+  ((uint16_t *)(block + BBBV_OFFSET))[slot] = result.bbbv;
+  (block + TRANSFORM_OFFSET)[slot] = result.transform;
+  (block + RESULT_OFFSET)[slot] = result.result;
+
+  // publish the record only once all of its fields are written
+  std::atomic_thread_fence(std::memory_order_release);
+  ((ResultFileHeader *)this->mapping)->count = count + 1;
+  return true;
+}
+
+uint64_t ResultStore::size()
+{
+  if (this->mapping == nullptr)
+    return 0;
+
+  // never trust the header past the end of the file
+  uint64_t count = ((ResultFileHeader *)this->mapping)->count;
+  uint64_t mapped = (this->mappingSize - sizeof(ResultFileHeader)) / BLOCK_SIZE * RESULT_BLOCK_RECORDS;
+  return count < mapped ? count : mapped;
+}
+
+uint64_t ResultStore::blockCount()
+{
+  return (this->size() + RESULT_BLOCK_RECORDS - 1) / RESULT_BLOCK_RECORDS;
+}
+
+ResultBlock ResultStore::block(uint64_t index)
+{
+  uint64_t count = this->size();
+  uint64_t first = index * RESULT_BLOCK_RECORDS;
+  const uint8_t *block = this->mapping + sizeof(ResultFileHeader) + index * BLOCK_SIZE;
+
+  ResultBlock columns;
+  columns.count = count - first < RESULT_BLOCK_RECORDS ? count - first : RESULT_BLOCK_RECORDS;
+  columns.poolIndex = (const uint32_t *)(block + POOL_INDEX_OFFSET);
+  columns.duration = (const uint32_t *)(block + DURATION_OFFSET);
+  columns.firstClick = (const uint16_t *)(block + FIRST_CLICK_OFFSET);
+  columns.reveals = (const uint16_t *)(block + REVEALS_OFFSET);
+  columns.flags = (const uint16_t *)(block + FLAGS_OFFSET);
+  columns.bbbv = (const uint16_t *)(block + BBBV_OFFSET);
+  columns.transform = block + TRANSFORM_OFFSET;
+  columns.result = block + RESULT_OFFSET;
+  return columns;
+}
+
+bool ResultStore::map()
+{
+  struct stat info;
+  if (fstat(this->fd, &info) != 0 || (size_t)info.st_size < sizeof(ResultFileHeader))
+    return false;
+
+  int protection = this->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *mapping = mmap(nullptr, info.st_size, protection, MAP_SHARED, this->fd, 0);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  this->mapping = (uint8_t *)mapping;
+  this->mappingSize = info.st_size;
+  return true;
+}
+
+void ResultStore::unmap()
+{
+  if (this->mapping != nullptr)
+  {
+    munmap(this->mapping, this->mappingSize);
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+  }
+}
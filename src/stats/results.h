@@ -0,0 +1,112 @@
+#pragma once
+#include <cinttypes>
+#include <string>
+
+/**
+ * The pool index recorded for boards generated on-device (no pool, or no safe pool board)
+ */
+const uint32_t RESULT_NO_POOL_INDEX = 0xFFFFFFFF;
+
+/**
+ * Records are stored in blocks of this many, each block holds one array per field
+ */
+const uint32_t RESULT_BLOCK_RECORDS = 65536;
+
+/**
+ * One finished game
+ */
+struct GameResult
+{
+  // index of the board in boards.bin, or RESULT_NO_POOL_INDEX
+  uint32_t poolIndex;
+  // symmetry transform the pool board was served with (0 - 3)
+  uint8_t transform;
+  // cell of the first reveal (x + y * 30), in screen coordinates
+  uint16_t firstClick;
+  // 1: win, 2: loss (same as the game state)
+  uint8_t result;
+  // milliseconds from the start of the game to the end
+  uint32_t duration;
+  uint16_t reveals;
+  uint16_t flags;
+  // the minimum number of clicks needed to clear the board
+  uint16_t bbbv;
+};
+
+/**
+ * Column pointers into one block of the store
+ * Every array holds count entries.
+ */
+struct ResultBlock
+{
+  uint32_t count;
+  const uint32_t *poolIndex;
+  const uint8_t *transform;
+  const uint16_t *firstClick;
+  const uint8_t *result;
+  const uint32_t *duration;
+  const uint16_t *reveals;
+  const uint16_t *flags;
+  const uint16_t *bbbv;
+};
+
+/**
+ * Append-only, memory-mapped columnar file of game results
+ * The file is a small header followed by blocks of RESULT_BLOCK_RECORDS records,
+ * each block storing its fields as separate arrays, so queries only touch the columns they read.
+ * The record count in the header is bumped after a record is written, so readers never see a partial record.
+ */
+class ResultStore
+{
+public:
+  ResultStore();
+  ~ResultStore();
+
+  /**
+   * Opens (or, when writable, creates) a result file
+   * @param path The file path
+   * @param writable Open for appending (true) or read-only (false).
+   *                 Only one store can have a file open for appending, others fail to open it.
+   * @return false if the file could not be opened, is not a result file, or already has a writer
+   */
+  bool open(std::string path, bool writable);
+
+  void close();
+
+  bool isOpen();
+
+  /**
+   * Appends a record, growing the file by a block when the last one is full
+   * @param result The record
+   * @return false if the store is read-only or the file could not grow
+   */
+  bool append(const GameResult &result);
+
+  /**
+   * @return The number of records
+   */
+  uint64_t size();
+
+  /**
+   * @return The number of (possibly partly filled) blocks
+   */
+  uint64_t blockCount();
+
+  /**
+   * @param index The block index
+   * @return The columns of the block
+   */
+  ResultBlock block(uint64_t index);
+
+private:
+  int fd;
+  bool writable;
+  uint8_t *mapping;
+  size_t mappingSize;
+
+  /**
+   * Maps the file at its current size
+   */
+  bool map();
+  void unmap();
+};
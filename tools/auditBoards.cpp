@@ -0,0 +1,367 @@
+// Verifies and cleans a board pool (assets/compiled/boards.bin), e.g.
+//   bin/auditBoards assets/compiled/boards.bin -o boards.clean.bin --drop retire.txt
+// Every board is checked in parallel:
+// - every nibble is 0, 1 (mine) or 2 (ok starting spot)
+// - it has exactly MINE_COUNT mines
+// - the ok starting spots are recomputed from the board: every empty tile of the opening the generator started in
+// - boards that are mirror images of an earlier board (under any of the symmetry transforms) are duplicates
+// Boards keep their order, so pool indices shift after removed boards (older results files no longer line up).
+
+#include "../src/minesweeper/board.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum BoardStatus
+{
+  BOARD_OK,
+  // the ok starting spots were wrong and have been recomputed
+  BOARD_FIXED,
+  BOARD_BAD_NIBBLE,
+  BOARD_BAD_MINE_COUNT,
+  // no ok starting spot, generateBoard could never serve it
+  BOARD_NO_SAFE_START,
+  // the ok starting spots are spread over several openings, so the solved one is unknown
+  BOARD_AMBIGUOUS_START,
+  BOARD_DUPLICATE,
+  // listed in --drop, or a mirror image of a listed board
+  BOARD_DROPPED,
+  BOARD_STATUS_COUNT
+};
+
+static const char *STATUS_NAMES[BOARD_STATUS_COUNT] = {
+    "ok",
+    "fixed starting spots",
+    "bad nibble",
+    "wrong mine count",
+    "no safe start",
+    "ambiguous start",
+    "duplicate",
+    "dropped"};
+
+// the mine layout as a 390 bit mask, the same for a board and all of its mirror images
+typedef std::array<uint64_t, 7> MineMask;
+
+static MineMask canonicalMines(const uint8_t *board)
+{
+  MineMask masks[BOARD_TRANSFORM_COUNT] = {};
+  for (int i = 0; i < 30 * 13; i++)
+  {
+    if (board[i] != 9)
+      continue;
+
+    // only the mines need mapping through the transforms
+    for (int transform = 0; transform < BOARD_TRANSFORM_COUNT; transform++)
+    {
+      int cell = transformCell(i, transform);
+      masks[transform][cell / 64] |= 1ull << (cell % 64);
+    }
+  }
+
+  return *std::min_element(masks, masks + BOARD_TRANSFORM_COUNT);
+}
+
+static uint64_t hashMask(const MineMask &mask)
+{
+  // splitmix64 finalizer over every word
+  uint64_t hash = 0;
+  for (uint64_t word : mask)
+  {
+    hash += word + 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+  }
+  return hash;
+}
+
+/**
+ * Checks one encoded board and writes its cleaned encoding
+ * @param entry The encoded board
+ * @param cleaned The cleaned board (ENCODED_BOARD_SIZE bytes), valid for BOARD_OK and BOARD_FIXED
+ * @param mines The canonical mine layout, valid for BOARD_OK and BOARD_FIXED
+ * @return The status
+ */
+static BoardStatus auditBoard(const uint8_t *entry, uint8_t *cleaned, MineMask *mines)
+{
+  uint8_t board[30 * 13];
+  bool marked[30 * 13];
+  int mineCount = 0;
+  for (int i = 0; i < 30 * 13; i++)
+  {
+    uint8_t nibble = readBoardNibble(entry, i);
+    if (nibble > 2)
+      return BOARD_BAD_NIBBLE;
+
+    board[i] = nibble == 1 ? 9 : 0;
+    marked[i] = nibble == 2;
+    mineCount += nibble == 1;
+  }
+
+  if (mineCount != MINE_COUNT)
+    return BOARD_BAD_MINE_COUNT;
+
+  fillBoardNumbers(board);
+  int16_t openings[30 * 13];
+  findOpenings(board, openings);
+
+  // the generator marks the empty tiles its first reveal opened, which is one opening.
+  // marks on numbered tiles are dropped, marks in two openings can't be trusted
+  int start = -1;
+  for (int i = 0; i < 30 * 13; i++)
+  {
+    if (!marked[i] || openings[i] == -1)
+      continue;
+
+    if (start == -1)
+      start = openings[i];
+    else if (openings[i] != start)
+      return BOARD_AMBIGUOUS_START;
+  }
+
+  if (start == -1)
+    return BOARD_NO_SAFE_START;
+
+  // re-encode, every empty tile of the opening is an ok starting spot
+  bool changed = false;
+  for (int i = 0; i < 30 * 13; i += 2)
+  {
+    uint8_t high = board[i] == 9 ? 1 : (openings[i] == start ? 2 : 0);
+    uint8_t low = board[i + 1] == 9 ? 1 : (openings[i + 1] == start ? 2 : 0);
+    cleaned[i / 2] = high << 4 | low;
+    changed |= cleaned[i / 2] != entry[i / 2];
+  }
+
+  *mines = canonicalMines(board);
+  return changed ? BOARD_FIXED : BOARD_OK;
+}
+
+static int usage()
+{
+  std::cout << "Usage: auditBoards <boards.bin> [-o cleaned.bin] [--drop indices.txt] [--threads n]" << std::endl;
+  return 1;
+}
+
+// a whole positive number, nothing else
+static bool parseCount(const char *text, int *value)
+{
+  char *end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || errno != 0 || parsed < 1 || parsed > INT_MAX)
+    return false;
+
+  *value = parsed;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+    return usage();
+
+  std::string path = argv[1];
+  std::string outputPath;
+  std::string dropPath;
+  int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 2; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+    {
+      outputPath = argv[++i];
+    }
+    else if (arg == "--drop" && i + 1 < argc)
+    {
+      dropPath = argv[++i];
+    }
+    else if (arg == "--threads" && i + 1 < argc)
+    {
+      if (!parseCount(argv[++i], &threadCount))
+      {
+        std::cout << "Not a thread count: " << argv[i] << std::endl;
+        return usage();
+      }
+    }
+    else
+    {
+      // a mistyped option would silently write an uncleaned pool
+      std::cout << "Unknown argument, or missing its value: " << arg << std::endl;
+      return usage();
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < 2)
+  {
+    std::cout << "Could not read board pool: " << path << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+
+  const uint8_t *file = (const uint8_t *)mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (file == MAP_FAILED)
+  {
+    std::cout << "Could not map board pool: " << path << std::endl;
+    close(fd);
+    return 1;
+  }
+
+  // trust the file size over the 16 bit count in the header
+  uint16_t headerCount = file[0] | file[1] << 8;
+  size_t boardCount = (info.st_size - 2) / ENCODED_BOARD_SIZE;
+  if (headerCount != boardCount)
+    std::cout << "Warning: header says " << headerCount << " boards, file holds " << boardCount << std::endl;
+  if ((info.st_size - 2) % ENCODED_BOARD_SIZE != 0)
+    std::cout << "Warning: " << (info.st_size - 2) % ENCODED_BOARD_SIZE << " trailing bytes ignored" << std::endl;
+
+  const uint8_t *boards = file + 2;
+  std::vector<uint8_t> status(boardCount);
+  std::vector<uint8_t> cleaned(boardCount * ENCODED_BOARD_SIZE);
+  std::vector<MineMask> mines(boardCount);
+
+  // each thread audits a contiguous range of boards
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; t++)
+  {
+    size_t first = boardCount * t / threadCount;
+    size_t last = boardCount * (t + 1) / threadCount;
+    threads.emplace_back([&, first, last]()
+                         {
+                           for (size_t i = first; i < last; i++)
+                           {
+                             status[i] = auditBoard(boards + i * ENCODED_BOARD_SIZE, cleaned.data() + i * ENCODED_BOARD_SIZE, &mines[i]);
+                           } });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+
+  munmap((void *)file, info.st_size);
+  close(fd);
+
+  // retired boards are applied after dedup, so their mirror images go too
+  std::vector<bool> retired(boardCount);
+  if (!dropPath.empty())
+  {
+    std::ifstream dropList(dropPath);
+    size_t index;
+    while (dropList >> index)
+    {
+      if (index < boardCount)
+        retired[index] = true;
+    }
+  }
+
+  // dedupe: sort the valid boards by mine hash, the first board of every layout is kept
+  std::vector<std::pair<uint64_t, uint32_t>> byHash;
+  for (size_t i = 0; i < boardCount; i++)
+  {
+    if (status[i] == BOARD_OK || status[i] == BOARD_FIXED)
+      byHash.push_back({hashMask(mines[i]), (uint32_t)i});
+  }
+  std::sort(byHash.begin(), byHash.end());
+
+  for (size_t run = 0; run < byHash.size();)
+  {
+    size_t end = run;
+    while (end < byHash.size() && byHash[end].first == byHash[run].first)
+      end++;
+
+    // a run shares a hash, compare the masks in case of a collision
+    for (size_t i = run + 1; i < end; i++)
+    {
+      for (size_t j = run; j < i; j++)
+      {
+        if (status[byHash[j].second] != BOARD_DUPLICATE && mines[byHash[j].second] == mines[byHash[i].second])
+        {
+          status[byHash[i].second] = BOARD_DUPLICATE;
+          break;
+        }
+      }
+    }
+
+    // the game plays every board in all transforms, so a retired layout is dropped in every copy
+    for (size_t i = run; i < end; i++)
+    {
+      if (!retired[byHash[i].second])
+        continue;
+
+      for (size_t j = run; j < end; j++)
+      {
+        if (mines[byHash[j].second] == mines[byHash[i].second])
+          status[byHash[j].second] = BOARD_DROPPED;
+      }
+    }
+    run = end;
+  }
+
+  // listed boards that failed the audit count as dropped too
+  for (size_t i = 0; i < boardCount; i++)
+  {
+    if (retired[i])
+      status[i] = BOARD_DROPPED;
+  }
+
+  // pack the kept boards together, in their original order
+  size_t kept = 0;
+  size_t counts[BOARD_STATUS_COUNT] = {};
+  for (size_t i = 0; i < boardCount; i++)
+  {
+    counts[status[i]]++;
+    if (status[i] != BOARD_OK && status[i] != BOARD_FIXED)
+      continue;
+
+    if (kept != i)
+      memcpy(cleaned.data() + kept * ENCODED_BOARD_SIZE, cleaned.data() + i * ENCODED_BOARD_SIZE, ENCODED_BOARD_SIZE);
+    kept++;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Audited " << boardCount << " boards in " << seconds << "s on " << threadCount << " threads" << std::endl;
+  for (int i = 0; i < BOARD_STATUS_COUNT; i++)
+  {
+    if (counts[i] > 0)
+      std::cout << "  " << STATUS_NAMES[i] << ": " << counts[i] << std::endl;
+  }
+  std::cout << "Kept " << kept << " boards" << std::endl;
+
+  if (outputPath.empty())
+    return 0;
+
+  // the game reads a 16 bit count
+  if (kept > 65535)
+  {
+    std::cout << "Warning: the game can only load 65535 boards, the rest are left out" << std::endl;
+    kept = 65535;
+  }
+
+  std::ofstream output(outputPath, std::ios::binary);
+  uint8_t header[2] = {(uint8_t)(kept & 0xFF), (uint8_t)(kept >> 8)};
+  output.write((const char *)header, 2);
+  output.write((const char *)cleaned.data(), kept * ENCODED_BOARD_SIZE);
+  if (!output.good())
+  {
+    std::cout << "Could not write " << outputPath << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << outputPath << std::endl;
+  return 0;
+}
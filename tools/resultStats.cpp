@@ -0,0 +1,233 @@
+// Aggregates a results file written by the game (--results), e.g.
+//   bin/resultStats results.bin --min-games 50 --retire-below 0.05 --retire-above 0.95 --retire-list retire.txt
+// Blocks of the file are spread over every core, each thread keeps its own totals and they are merged at the end.
+
+#include "../src/stats/results.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// win times are bucketed by whole seconds, the last bucket holds everything slower
+const int MAX_SECONDS = 1000;
+
+struct Aggregate
+{
+  uint64_t games = 0;
+  uint64_t wins = 0;
+  uint64_t revealTotal = 0;
+  uint64_t flagTotal = 0;
+  uint64_t bbbvTotal = 0;
+  double bbbvPerSecondTotal = 0;
+  std::vector<uint64_t> poolGames = std::vector<uint64_t>(65536);
+  std::vector<uint64_t> poolWins = std::vector<uint64_t>(65536);
+  std::vector<uint64_t> firstClicks = std::vector<uint64_t>(30 * 13);
+  std::vector<uint64_t> winSeconds = std::vector<uint64_t>(MAX_SECONDS + 1);
+
+  void add(const ResultBlock &block)
+  {
+    for (uint32_t i = 0; i < block.count; i++)
+    {
+      bool won = block.result[i] == 1;
+      this->games++;
+      this->wins += won;
+      this->revealTotal += block.reveals[i];
+      this->flagTotal += block.flags[i];
+      this->bbbvTotal += block.bbbv[i];
+
+      // the board pool holds at most 65535 boards
+      if (block.poolIndex[i] < 65536)
+      {
+        this->poolGames[block.poolIndex[i]]++;
+        this->poolWins[block.poolIndex[i]] += won;
+      }
+
+      if (block.firstClick[i] < 30 * 13)
+        this->firstClicks[block.firstClick[i]]++;
+
+      if (won)
+      {
+        this->winSeconds[std::min<uint32_t>(block.duration[i] / 1000, MAX_SECONDS)]++;
+        if (block.duration[i] > 0)
+          this->bbbvPerSecondTotal += block.bbbv[i] * 1000.0 / block.duration[i];
+      }
+    }
+  }
+
+  void merge(const Aggregate &other)
+  {
+    this->games += other.games;
+    this->wins += other.wins;
+    this->revealTotal += other.revealTotal;
+    this->flagTotal += other.flagTotal;
+    this->bbbvTotal += other.bbbvTotal;
+    this->bbbvPerSecondTotal += other.bbbvPerSecondTotal;
+    for (int i = 0; i < 65536; i++)
+    {
+      this->poolGames[i] += other.poolGames[i];
+      this->poolWins[i] += other.poolWins[i];
+    }
+    for (int i = 0; i < 30 * 13; i++)
+      this->firstClicks[i] += other.firstClicks[i];
+    for (int i = 0; i <= MAX_SECONDS; i++)
+      this->winSeconds[i] += other.winSeconds[i];
+  }
+};
+
+// the win time (in seconds) below which a fraction of wins fall
+static int winPercentile(const Aggregate &total, double fraction)
+{
+  uint64_t target = (uint64_t)(total.wins * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i <= MAX_SECONDS; i++)
+  {
+    seen += total.winSeconds[i];
+    if (seen > target)
+      return i;
+  }
+  return MAX_SECONDS;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cout << "Usage: resultStats <results.bin> [--min-games n] [--retire-below rate] [--retire-above rate] [--retire-list out.txt] [--threads n]" << std::endl;
+    return 1;
+  }
+
+  std::string path = argv[1];
+  uint64_t minGames = 20;
+  double retireBelow = 0;
+  double retireAbove = 1;
+  std::string retirePath;
+  int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 2; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--min-games" && i + 1 < argc)
+    {
+      minGames = std::stoull(argv[++i]);
+    }
+    else if (arg == "--retire-below" && i + 1 < argc)
+    {
+      retireBelow = std::stod(argv[++i]);
+    }
+    else if (arg == "--retire-above" && i + 1 < argc)
+    {
+      retireAbove = std::stod(argv[++i]);
+    }
+    else if (arg == "--retire-list" && i + 1 < argc)
+    {
+      retirePath = argv[++i];
+    }
+    else if (arg == "--threads" && i + 1 < argc)
+    {
+      threadCount = std::max(1, std::stoi(argv[++i]));
+    }
+  }
+
+  ResultStore store;
+  if (!store.open(path, false))
+    return 1;
+
+  // threads pull blocks off a shared counter, so a slow core never holds up the rest
+  uint64_t blockCount = store.blockCount();
+  std::atomic<uint64_t> nextBlock(0);
+  std::vector<Aggregate> partials(threadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadCount; t++)
+  {
+    threads.emplace_back([&, t]()
+                         {
+                           uint64_t block;
+                           while ((block = nextBlock.fetch_add(1)) < blockCount)
+                           {
+                             partials[t].add(store.block(block));
+                           } });
+  }
+
+  Aggregate total;
+  for (int t = 0; t < threadCount; t++)
+  {
+    threads[t].join();
+    total.merge(partials[t]);
+  }
+
+  if (total.games == 0)
+  {
+    std::cout << "No games recorded" << std::endl;
+    return 0;
+  }
+
+  std::cout << "Games: " << total.games << std::endl;
+  std::cout << "Win rate: " << 100.0 * total.wins / total.games << "%" << std::endl;
+  std::cout << "Average reveals: " << (double)total.revealTotal / total.games << ", flags: " << (double)total.flagTotal / total.games << ", 3BV: " << (double)total.bbbvTotal / total.games << std::endl;
+  if (total.wins > 0)
+  {
+    std::cout << "Win time (s): p50 " << winPercentile(total, 0.5) << ", p90 " << winPercentile(total, 0.9) << ", p99 " << winPercentile(total, 0.99) << std::endl;
+    std::cout << "Average 3BV/s (wins): " << total.bbbvPerSecondTotal / total.wins << std::endl;
+  }
+
+  // first clicks, as a 0-9 heatmap of the board
+  uint64_t mostClicked = *std::max_element(total.firstClicks.begin(), total.firstClicks.end());
+  std::cout << std::endl
+            << "First clicks:" << std::endl;
+  for (int y = 0; y < 13; y++)
+  {
+    for (int x = 0; x < 30; x++)
+    {
+      uint64_t clicks = total.firstClicks[x + y * 30];
+      std::cout << (clicks == 0 ? '.' : (char)('0' + clicks * 9 / mostClicked));
+    }
+    std::cout << std::endl;
+  }
+
+  // pool boards with enough games to judge, hardest first
+  std::vector<int> judged;
+  for (int i = 0; i < 65536; i++)
+  {
+    if (total.poolGames[i] >= minGames && total.poolGames[i] > 0)
+      judged.push_back(i);
+  }
+  auto winRate = [&](int index)
+  { return (double)total.poolWins[index] / total.poolGames[index]; };
+  std::sort(judged.begin(), judged.end(), [&](int a, int b)
+            { return winRate(a) < winRate(b); });
+
+  std::cout << std::endl
+            << "Pool boards with at least " << minGames << " games: " << judged.size() << std::endl;
+  if (!judged.empty())
+  {
+    int shown = std::min<int>(10, judged.size());
+    std::cout << "Hardest:";
+    for (int i = 0; i < shown; i++)
+      std::cout << " " << judged[i] << " (" << 100 * winRate(judged[i]) << "%)";
+    std::cout << std::endl
+              << "Easiest:";
+    for (int i = 0; i < shown; i++)
+      std::cout << " " << judged[judged.size() - 1 - i] << " (" << 100 * winRate(judged[judged.size() - 1 - i]) << "%)";
+    std::cout << std::endl;
+  }
+
+  // boards outside the wanted win rate, one pool index per line (for auditBoards --drop)
+  int retired = 0;
+  std::ofstream retireList;
+  if (!retirePath.empty())
+    retireList.open(retirePath);
+  for (int index : judged)
+  {
+    if (winRate(index) >= retireBelow && winRate(index) <= retireAbove)
+      continue;
+
+    retired++;
+    if (retireList.is_open())
+      retireList << index << std::endl;
+  }
+  std::cout << "Outside " << retireBelow << " - " << retireAbove << " win rate: " << retired << std::endl;
+
+  return 0;
+}